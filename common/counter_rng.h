@@ -0,0 +1,129 @@
+// Counter-based random numbers shared by all programs (1a, 1c, 1d, 2a, 2b, 2c).
+//
+// Value i of a stream is a pure function of (seed, stream, i): the SplitMix64 finalizer
+// applied to key + (i + 1) * gamma, where the key mixes the seed with a stream id. There is
+// no state to share or advance, so any thread can generate any slice of a buffer and the
+// contents depend only on the seed, never on the number of threads or how the work is split.
+// Use one stream id per buffer so that buffers filled from the same seed are independent.
+//
+// crng_parallel_fill() splits a fill over pthreads; OpenMP programs call the per-element
+// functions from a parallel for.
+
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define CRNG_GAMMA 0x9e3779b97f4a7c15ULL   // 2^64 / golden ratio, the SplitMix64 increment
+
+static inline uint64_t crng_mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Key of stream `stream` under `seed`
+static inline uint64_t crng_key(uint64_t seed, uint64_t stream) {
+    return crng_mix(seed ^ crng_mix((stream + 1) * CRNG_GAMMA));
+}
+
+// 64 random bits for element index of the keyed stream
+static inline uint64_t crng_at(uint64_t key, uint64_t index) {
+    return crng_mix(key + (index + 1) * CRNG_GAMMA);
+}
+
+// Uniform in [0, bound) by a 64x64 -> 128 multiply (no division, bias below 2^-32 for 32-bit bounds)
+static inline uint64_t crng_below(uint64_t key, uint64_t index, uint64_t bound) {
+    return (uint64_t)(((unsigned __int128)crng_at(key, index) * bound) >> 64);
+}
+
+// Uniform int in [lo, hi]
+static inline int crng_int_in(uint64_t key, uint64_t index, int lo, int hi) {
+    return lo + (int)crng_below(key, index, (uint64_t)((long long)hi - lo + 1));
+}
+
+// Uniform in [-max, max] without 0
+static inline int crng_nonzero_in(uint64_t key, uint64_t index, int max) {
+    int v = (int)crng_below(key, index, 2 * (uint64_t)max) - max;
+    return (v >= 0) ? v + 1 : v;
+}
+
+// Element index of a keyed random permutation of [0, n): a 4-round Feistel network on the
+// smallest even number of bits covering n, cycle-walking until the value falls below n.
+// Distinct indices give distinct values, e.g. to pick exactly k cells out of n in parallel.
+static inline uint64_t crng_permute(uint64_t key, uint64_t index, uint64_t n) {
+    int half = 1;
+    while (half < 32 && (1ULL << (2 * half)) < n) ++half;
+    uint64_t mask = (1ULL << half) - 1;
+    uint64_t x = index;
+    do {
+        uint64_t left = x >> half, right = x & mask;
+        for (uint64_t round = 0; round < 4; ++round) {
+            uint64_t next = left ^ (crng_at(key, (round << 60) ^ right) & mask);
+            left = right;
+            right = next;
+        }
+        x = (left << half) | right;
+    } while (x >= n);
+    return x;
+}
+
+// -------- pthreads fill --------
+// fill(ctx, start, end) must write elements [start, end) only
+typedef void (*crng_fill_fn)(void *ctx, long start, long end);
+
+struct crng_fill_task {
+    crng_fill_fn fill;
+    void *ctx;
+    long start, end;
+};
+
+static inline void *crng_fill_run(void *arg) {
+    struct crng_fill_task *task = (struct crng_fill_task *)arg;
+    task->fill(task->ctx, task->start, task->end);
+    return NULL;
+}
+
+// Run fill over [0, count) split into equal slices on `threads` pthreads
+static inline void crng_parallel_fill(long count, int threads, crng_fill_fn fill, void *ctx) {
+    if (threads < 1) threads = 1;
+    if (threads > count) threads = (count > 0) ? (int)count : 1;
+    pthread_t *ids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    struct crng_fill_task *tasks = (struct crng_fill_task *)malloc(threads * sizeof(struct crng_fill_task));
+    for (int t = 0; t < threads; ++t) {
+        tasks[t].fill = fill;
+        tasks[t].ctx = ctx;
+        tasks[t].start = count * t / threads;
+        tasks[t].end = count * (t + 1) / threads;
+        pthread_create(&ids[t], NULL, crng_fill_run, &tasks[t]);
+    }
+    for (int t = 0; t < threads; ++t) {
+        pthread_join(ids[t], NULL);
+    }
+    free(ids);
+    free(tasks);
+}
+
+// dst[i] uniform in [lo, hi]
+struct crng_int_fill {
+    int *dst;
+    uint64_t key;
+    int lo, hi;
+};
+
+static inline void crng_int_fill_range(void *ctx, long start, long end) {
+    struct crng_int_fill *f = (struct crng_int_fill *)ctx;
+    for (long i = start; i < end; ++i) {
+        f->dst[i] = crng_int_in(f->key, i, f->lo, f->hi);
+    }
+}
+
+// Fill count ints uniformly in [lo, hi] from stream `stream` of `seed` on `threads` pthreads
+static inline void crng_fill_ints(int *dst, long count, uint64_t seed, uint64_t stream, int lo, int hi, int threads) {
+    struct crng_int_fill f = { dst, crng_key(seed, stream), lo, hi };
+    crng_parallel_fill(count, threads, crng_int_fill_range, &f);
+}
+
+#endif // COUNTER_RNG_H
@@ -0,0 +1,229 @@
+// Shared algorithm dispatcher for the polynomial multiplication programs (1a, 2a).
+//
+// Each program provides its own kernels; this header only decides which one to run.
+// The decision is a lookup in a profile measured on the host by a calibration run:
+// for every (threads, coefficient bits) pair the profile stores a ladder of degrees
+// and the fastest algorithm at each rung. Without a profile, fixed defaults are used.
+//
+// Profile file format (text, one rung per line, '#' starts a comment):
+//   <threads> <coeff_bits> <degree> <algorithm name>
+
+#ifndef POLY_DISPATCH_H
+#define POLY_DISPATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Ordered from the asymptotically slowest to the fastest
+#define POLY_ALG_SCHOOLBOOK 0
+#define POLY_ALG_KARATSUBA  1
+#define POLY_ALG_TOOM3      2
+#define POLY_ALG_TRANSFORM  3
+#define POLY_ALG_COUNT      4
+
+#define POLY_PROFILE_MAX_ENTRIES 1024
+#define POLY_CALIBRATE_MIN_DEGREE 16
+#define POLY_CALIBRATE_PRUNE 4.0         // Drop an algorithm once it is this many times slower than the best
+#define POLY_CALIBRATE_PRUNE_FLOOR 0.01  // ... and slower than this (seconds), so small-rung noise is ignored
+
+// Default crossovers when there is no profile for the current configuration
+#define POLY_DEFAULT_KARATSUBA_FROM 128
+#define POLY_DEFAULT_TOOM3_FROM     2048
+#define POLY_DEFAULT_TRANSFORM_FROM 16384
+
+static const char *poly_alg_names[POLY_ALG_COUNT] = { "schoolbook", "karatsuba", "toom3", "transform" };
+
+struct poly_profile_entry {
+    int threads;
+    int coeff_bits;
+    int degree;
+    int algorithm;
+};
+
+struct poly_profile {
+    int count;
+    struct poly_profile_entry entries[POLY_PROFILE_MAX_ENTRIES];
+};
+
+// Time one run of algorithm at the given degree (seconds); supplied by the program
+typedef double (*poly_time_fn)(int algorithm, int degree);
+
+static int poly_alg_from_name(const char *name) {
+    for (int a = 0; a < POLY_ALG_COUNT; ++a) {
+        if (strcmp(name, poly_alg_names[a]) == 0) return a;
+    }
+    return -1;
+}
+
+// Number of bits needed for the largest coefficient magnitude
+static int poly_coeff_bits(long long coeff_max) {
+    int bits = 0;
+    if (coeff_max < 0) coeff_max = -coeff_max;
+    while (coeff_max > 0) {
+        ++bits;
+        coeff_max >>= 1;
+    }
+    return bits;
+}
+
+// Largest |coefficient| of count ints (what the operands really hold, e.g. from a file)
+static long long poly_max_abs(const int *coeffs, long count) {
+    long long max_abs = 0;
+    for (long i = 0; i < count; ++i) {
+        long long c = coeffs[i];
+        if (c < 0) c = -c;
+        if (c > max_abs) max_abs = c;
+    }
+    return max_abs;
+}
+
+// Whether algorithm computes the exact product of two operands of m coefficients with
+// |coefficient| <= max_abs: NULL if it does, else the reason it cannot. Every algorithm needs
+// max_abs^2 * m in 64 bits; Karatsuba operand sums double per level and must stay within
+// karatsuba_sum_max (INT_MAX for int sums) with their products in 64 bits; the transform
+// recovers values below transform_modulus / 2 in magnitude. Toom-3 checks its own levels.
+static const char *poly_operand_limit(int algorithm, long long max_abs, long m, int karatsuba_cutoff,
+                                      long long karatsuba_sum_max, unsigned long long transform_modulus) {
+    double product = (double)max_abs * (double)max_abs * (double)m;
+    if (product >= 9.2e18) return "the product coefficients overflow 64 bits";
+    if (algorithm == POLY_ALG_KARATSUBA) {
+        double sum = (double)max_abs;
+        for (long len = m; len > karatsuba_cutoff; len = (len + 1) / 2) {
+            sum *= 2.0;
+            if (sum > (double)karatsuba_sum_max) return "the Karatsuba operand sums overflow";
+            if (sum * sum * (double)((len + 1) / 2) >= 9.2e18) return "the Karatsuba sub-products overflow 64 bits";
+        }
+    }
+    if (algorithm == POLY_ALG_TRANSFORM && product >= (double)transform_modulus / 2.0) {
+        return "the product coefficients exceed the range of the NTT primes";
+    }
+    return NULL;
+}
+
+// Load a profile; returns 0 on success, -1 if the file is missing or unreadable
+static int poly_profile_load(const char *path, struct poly_profile *profile) {
+    profile->count = 0;
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) && profile->count < POLY_PROFILE_MAX_ENTRIES) {
+        struct poly_profile_entry e;
+        char name[64];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%d %d %d %63s", &e.threads, &e.coeff_bits, &e.degree, name) != 4) continue;
+        e.algorithm = poly_alg_from_name(name);
+        if (e.algorithm < 0) continue;
+        profile->entries[profile->count++] = e;
+    }
+    fclose(file);
+    return 0;
+}
+
+static int poly_profile_save(const char *path, const struct poly_profile *profile) {
+    FILE *file = fopen(path, "w");
+    if (!file) return -1;
+    fprintf(file, "# threads coeff_bits degree algorithm\n");
+    for (int i = 0; i < profile->count; ++i) {
+        const struct poly_profile_entry *e = &profile->entries[i];
+        fprintf(file, "%d %d %d %s\n", e->threads, e->coeff_bits, e->degree, poly_alg_names[e->algorithm]);
+    }
+    fclose(file);
+    return 0;
+}
+
+// Drop all rungs measured for (threads, coeff_bits) so a new calibration replaces them
+static void poly_profile_clear(struct poly_profile *profile, int threads, int coeff_bits) {
+    int kept = 0;
+    for (int i = 0; i < profile->count; ++i) {
+        const struct poly_profile_entry *e = &profile->entries[i];
+        if (e->threads == threads && e->coeff_bits == coeff_bits) continue;
+        profile->entries[kept++] = *e;
+    }
+    profile->count = kept;
+}
+
+static int poly_default_algorithm(int degree) {
+    if (degree < POLY_DEFAULT_KARATSUBA_FROM) return POLY_ALG_SCHOOLBOOK;
+    if (degree < POLY_DEFAULT_TOOM3_FROM) return POLY_ALG_KARATSUBA;
+    if (degree < POLY_DEFAULT_TRANSFORM_FROM) return POLY_ALG_TOOM3;
+    return POLY_ALG_TRANSFORM;
+}
+
+// Pick the algorithm of the highest calibrated rung not above degree (the lowest
+// rung if degree is below all of them). Returns -1 if the configuration is not profiled.
+static int poly_profile_lookup(const struct poly_profile *profile, int threads, int coeff_bits, int degree) {
+    int best = -1, best_degree = -1;
+    int lowest = -1, lowest_degree = 0;
+    for (int i = 0; i < profile->count; ++i) {
+        const struct poly_profile_entry *e = &profile->entries[i];
+        if (e->threads != threads || e->coeff_bits != coeff_bits) continue;
+        if (e->degree <= degree && e->degree > best_degree) {
+            best = e->algorithm;
+            best_degree = e->degree;
+        }
+        if (lowest < 0 || e->degree < lowest_degree) {
+            lowest = e->algorithm;
+            lowest_degree = e->degree;
+        }
+    }
+    return (best >= 0) ? best : lowest;
+}
+
+// Measure every algorithm on a doubling ladder of degrees up to max_degree and store
+// the fastest per rung. An algorithm that falls far behind a winner of better asymptotic
+// order cannot catch up again, so it is not timed on the larger rungs.
+static void poly_calibrate(struct poly_profile *profile, int threads, int coeff_bits,
+                           int max_degree, poly_time_fn time_alg) {
+    int active[POLY_ALG_COUNT];
+    for (int a = 0; a < POLY_ALG_COUNT; ++a) active[a] = 1;
+
+    poly_profile_clear(profile, threads, coeff_bits);
+    printf("Calibrating for %d threads, %d-bit coefficients:\n", threads, coeff_bits);
+
+    for (int degree = POLY_CALIBRATE_MIN_DEGREE; degree <= max_degree; degree *= 2) {
+        double times[POLY_ALG_COUNT];
+        int best = -1;
+
+        printf("  degree %9d:", degree);
+        for (int a = 0; a < POLY_ALG_COUNT; ++a) {
+            if (!active[a]) {
+                printf("  %s -", poly_alg_names[a]);
+                continue;
+            }
+            // Best of three to filter out noise on the small rungs
+            times[a] = time_alg(a, degree);
+            for (int rep = 1; rep < 3; ++rep) {
+                double t = time_alg(a, degree);
+                if (t < times[a]) times[a] = t;
+            }
+            printf("  %s %.6f", poly_alg_names[a], times[a]);
+            if (best < 0 || times[a] < times[best]) best = a;
+        }
+        printf("  -> %s\n", poly_alg_names[best]);
+
+        for (int a = 0; a < best; ++a) {
+            if (active[a] && times[a] > POLY_CALIBRATE_PRUNE_FLOOR
+                && times[a] > POLY_CALIBRATE_PRUNE * times[best]) active[a] = 0;
+        }
+        if (profile->count < POLY_PROFILE_MAX_ENTRIES) {
+            struct poly_profile_entry e = { threads, coeff_bits, degree, best };
+            profile->entries[profile->count++] = e;
+        }
+        if (degree > max_degree / 2) break;   // Next rung is past max_degree (and avoids overflow)
+    }
+}
+
+// Algorithm to run for this call: the profile if it covers the configuration, else the defaults
+static int poly_dispatch(const char *profile_path, int threads, int coeff_bits, int degree, int *from_profile) {
+    static struct poly_profile profile;
+    int algorithm = -1;
+    if (poly_profile_load(profile_path, &profile) == 0) {
+        algorithm = poly_profile_lookup(&profile, threads, coeff_bits, degree);
+    }
+    *from_profile = (algorithm >= 0);
+    return (algorithm >= 0) ? algorithm : poly_default_algorithm(degree);
+}
+
+#endif // POLY_DISPATCH_H
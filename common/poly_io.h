@@ -0,0 +1,237 @@
+// Binary polynomial files for the polynomial multiplication programs (1a, 2a).
+//
+// A file is a fixed header followed by the coefficients, lowest degree first, as raw
+// host-order integers. Operands (int32) are mmap'd and used in place, so there is no parse
+// or copy step. Products (int64) are written through a background thread: the multiplier
+// hands over each block of coefficients as soon as it is final and keeps computing while
+// the block goes to disk with pwrite() at its own offset (blocks may arrive in any order).
+//
+//   offset 0   char     magic[8]     "POLYBIN"
+//   offset 8   uint32   byte_order   POLY_FILE_BYTE_ORDER as stored by the writer
+//   offset 12  uint32   coeff_bytes  4 (int32) or 8 (int64)
+//   offset 16  uint64   count        number of coefficients (degree + 1)
+//   offset 24  coefficients
+
+#ifndef POLY_IO_H
+#define POLY_IO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define POLY_FILE_MAGIC "POLYBIN"
+#define POLY_FILE_BYTE_ORDER 0x01020304u
+
+struct poly_file_header {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t coeff_bytes;
+    uint64_t count;
+};
+
+_Static_assert(sizeof(struct poly_file_header) == 24, "poly file header must be 24 bytes");
+
+struct poly_mapping {
+    void *base;
+    size_t length;
+};
+
+static void poly_file_init_header(struct poly_file_header *h, uint32_t coeff_bytes, uint64_t count) {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, POLY_FILE_MAGIC, sizeof(POLY_FILE_MAGIC));
+    h->byte_order = POLY_FILE_BYTE_ORDER;
+    h->coeff_bytes = coeff_bytes;
+    h->count = count;
+}
+
+// Map a polynomial file read-only and return its coefficients (NULL and a message on error)
+static const void *poly_file_map(const char *path, uint32_t coeff_bytes, uint64_t *count, struct poly_mapping *map) {
+    map->base = NULL;
+    map->length = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct poly_file_header)) {
+        fprintf(stderr, "%s is not a polynomial file\n", path);
+        close(fd);
+        return NULL;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Cannot map %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    const struct poly_file_header *h = (const struct poly_file_header *)base;
+    const char *error = NULL;
+    if (memcmp(h->magic, POLY_FILE_MAGIC, sizeof(POLY_FILE_MAGIC)) != 0) error = "bad magic";
+    else if (h->byte_order != POLY_FILE_BYTE_ORDER) error = "written with a different byte order";
+    else if (h->coeff_bytes != coeff_bytes) error = "unexpected coefficient size";
+    else if (h->count == 0 || h->count > ((uint64_t)st.st_size - sizeof(*h)) / coeff_bytes
+             || sizeof(*h) + h->count * coeff_bytes != (uint64_t)st.st_size) error = "size does not match the header";
+    if (error) {
+        fprintf(stderr, "%s: %s\n", path, error);
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    // The coefficients are read once front to back
+    posix_madvise(base, st.st_size, POSIX_MADV_SEQUENTIAL);
+    map->base = base;
+    map->length = st.st_size;
+    *count = h->count;
+    return (const char *)base + sizeof(*h);
+}
+
+static void poly_file_unmap(struct poly_mapping *map) {
+    if (map->base) munmap(map->base, map->length);
+    map->base = NULL;
+    map->length = 0;
+}
+
+// Write a whole polynomial file in one go (used to create operand files); 0 on success
+static int poly_file_write(const char *path, const void *coeffs, uint32_t coeff_bytes, uint64_t count) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct poly_file_header h;
+    poly_file_init_header(&h, coeff_bytes, count);
+    int ok = fwrite(&h, sizeof(h), 1, file) == 1 && fwrite(coeffs, coeff_bytes, count, file) == count;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) fprintf(stderr, "Cannot write %s\n", path);
+    return ok ? 0 : -1;
+}
+
+// -------- Streaming product writer --------
+struct poly_write_block {
+    const long long *src;
+    uint64_t start, count;        // Coefficient range [start, start + count) of the product
+};
+
+struct poly_writer {
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    struct poly_write_block *queue;
+    long head, tail, capacity;    // Pending blocks are queue[head .. tail)
+    int closed;
+    int error;
+    uint64_t bytes;               // Written so far
+};
+
+static void *poly_writer_run(void *arg) {
+    struct poly_writer *w = (struct poly_writer *)arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (w->head == w->tail && !w->closed) {
+            pthread_cond_wait(&w->ready, &w->lock);
+        }
+        if (w->head == w->tail) break;            // closed and drained
+        struct poly_write_block block = w->queue[w->head++];
+        pthread_mutex_unlock(&w->lock);
+
+        const char *src = (const char *)block.src;
+        size_t left = block.count * sizeof(long long);
+        off_t offset = sizeof(struct poly_file_header) + block.start * sizeof(long long);
+        int failed = 0;
+        while (left > 0) {
+            ssize_t written = pwrite(w->fd, src, left, offset);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) {
+                failed = 1;
+                break;
+            }
+            src += written;
+            offset += written;
+            left -= written;
+        }
+
+        pthread_mutex_lock(&w->lock);
+        if (failed) w->error = 1;
+        w->bytes += block.count * sizeof(long long) - left;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// Create the product file (int64, count coefficients) and start the writer thread; 0 on success
+static int poly_writer_open(struct poly_writer *w, const char *path, uint64_t count) {
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) {
+        fprintf(stderr, "Cannot create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct poly_file_header h;
+    poly_file_init_header(&h, sizeof(long long), count);
+    if (pwrite(w->fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)
+        || ftruncate(w->fd, sizeof(h) + count * sizeof(long long)) != 0) {
+        fprintf(stderr, "Cannot write %s: %s\n", path, strerror(errno));
+        close(w->fd);
+        return -1;
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->ready, NULL);
+    w->capacity = 256;
+    w->queue = (struct poly_write_block *)malloc(w->capacity * sizeof(struct poly_write_block));
+    w->head = w->tail = 0;
+    w->closed = 0;
+    w->error = 0;
+    w->bytes = sizeof(h);
+    pthread_create(&w->thread, NULL, poly_writer_run, w);
+    return 0;
+}
+
+// Queue src[0 .. count) as product coefficients [start, start + count); src must stay
+// unchanged until poly_writer_close(). Safe to call from several threads.
+static void poly_writer_submit(struct poly_writer *w, const long long *src, uint64_t start, uint64_t count) {
+    if (count == 0) return;
+    pthread_mutex_lock(&w->lock);
+    if (w->tail == w->capacity) {
+        if (w->head > 0) {
+            // Reuse the drained front of the queue before growing it
+            memmove(w->queue, w->queue + w->head, (w->tail - w->head) * sizeof(struct poly_write_block));
+            w->tail -= w->head;
+            w->head = 0;
+        }
+        if (w->tail == w->capacity) {
+            w->capacity *= 2;
+            w->queue = (struct poly_write_block *)realloc(w->queue, w->capacity * sizeof(struct poly_write_block));
+        }
+    }
+    struct poly_write_block block = { src, start, count };
+    w->queue[w->tail++] = block;
+    pthread_cond_signal(&w->ready);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Flush the remaining blocks, stop the thread and close the file; 0 if everything was written
+static int poly_writer_close(struct poly_writer *w) {
+    pthread_mutex_lock(&w->lock);
+    w->closed = 1;
+    pthread_cond_signal(&w->ready);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+
+    int error = w->error;
+    if (close(w->fd) != 0) error = 1;
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->ready);
+    free(w->queue);
+    return error ? -1 : 0;
+}
+
+#endif // POLY_IO_H
@@ -0,0 +1,112 @@
+// Arithmetic modulo a user-supplied prime for the polynomial multiplication programs (1a, 2a).
+//
+// Products are reduced with Montgomery's REDC (R = 2^64), which needs p odd and, here,
+// p < 2^63 so that the intermediate t + q*p of REDC fits in 128 bits. In a dot product one
+// operand is kept in Montgomery form (xR mod p) and the other as a plain residue, so
+// REDC(sum x_i R * y_i) is sum x_i y_i mod p with no conversion back.
+//
+// The reduction is lazy: every product is below p^2, so up to R/p of them can be summed
+// in 128 bits and still be a valid REDC input (< pR). For a 32-bit prime that is one
+// REDC per output coefficient; for a prime near 2^62, one every 4 products.
+
+#ifndef POLY_MODULAR_H
+#define POLY_MODULAR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define POLY_MOD_MAX_LAZY (1L << 30)
+
+typedef unsigned __int128 poly_u128;
+
+struct poly_mod {
+    uint64_t p;
+    uint64_t neg_pinv;    // -p^-1 mod 2^64
+    uint64_t r2;          // R^2 mod p
+    long lazy;            // Products summed between two reductions
+};
+
+// Reference reduction: one 128-bit division per multiply
+static uint64_t poly_mod_mulmod(uint64_t a, uint64_t b, uint64_t p) {
+    return (uint64_t)((poly_u128)a * b % p);
+}
+
+static uint64_t poly_mod_powmod(uint64_t base, uint64_t exp, uint64_t p) {
+    uint64_t result = 1;
+    base %= p;
+    while (exp > 0) {
+        if (exp & 1) result = poly_mod_mulmod(result, base, p);
+        base = poly_mod_mulmod(base, base, p);
+        exp >>= 1;
+    }
+    return result;
+}
+
+// Deterministic Miller-Rabin; these bases cover every 64-bit integer
+static int poly_mod_is_prime(uint64_t p) {
+    static const uint64_t bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+    if (p < 2) return 0;
+    for (int i = 0; i < 12; ++i) {
+        if (p % bases[i] == 0) return p == bases[i];
+    }
+    uint64_t d = p - 1;
+    int s = 0;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        ++s;
+    }
+    for (int i = 0; i < 12; ++i) {
+        uint64_t x = poly_mod_powmod(bases[i], d, p);
+        if (x == 1 || x == p - 1) continue;
+        int r = 1;
+        for (; r < s; ++r) {
+            x = poly_mod_mulmod(x, x, p);
+            if (x == p - 1) break;
+        }
+        if (r == s) return 0;
+    }
+    return 1;
+}
+
+// Precompute the Montgomery constants; returns -1 unless p is an odd prime below 2^63
+static int poly_mod_init(struct poly_mod *m, uint64_t p) {
+    if (p < 3 || (p >> 63) != 0 || !poly_mod_is_prime(p)) return -1;
+    // Newton iteration for p^-1 mod 2^64: p*p = 1 mod 8, each step doubles the correct bits
+    uint64_t inv = p;
+    for (int i = 0; i < 5; ++i) inv *= 2 - p * inv;
+    m->p = p;
+    m->neg_pinv = 0 - inv;
+    uint64_t r = (0 - p) % p;              // 2^64 mod p
+    m->r2 = poly_mod_mulmod(r, r, p);
+    m->lazy = (long)((UINT64_MAX / p < (uint64_t)POLY_MOD_MAX_LAZY) ? UINT64_MAX / p : POLY_MOD_MAX_LAZY);
+    return 0;
+}
+
+// REDC: t * R^-1 mod p for t < pR
+static inline uint64_t poly_mod_redc(const struct poly_mod *m, poly_u128 t) {
+    uint64_t q = (uint64_t)t * m->neg_pinv;
+    uint64_t u = (uint64_t)((t + (poly_u128)q * m->p) >> 64);
+    return (u >= m->p) ? u - m->p : u;
+}
+
+// x (a residue) into Montgomery form xR mod p
+static inline uint64_t poly_mod_to_mont(const struct poly_mod *m, uint64_t x) {
+    return poly_mod_redc(m, (poly_u128)x * m->r2);
+}
+
+// sum x_mont[i] * y[i] mod p, with x in Montgomery form and y plain: reduced once per lazy block
+static uint64_t poly_mod_dot(const struct poly_mod *m, const uint64_t *x_mont, const uint64_t *y, int count) {
+    uint64_t sum = 0;
+    for (int start = 0; start < count; start += m->lazy) {
+        int end = (count - start > m->lazy) ? start + (int)m->lazy : count;
+        poly_u128 acc = 0;
+        for (int i = start; i < end; ++i) {
+            acc += (poly_u128)x_mont[i] * y[i];
+        }
+        sum += poly_mod_redc(m, acc);          // both terms < p < 2^63: no wrap
+        if (sum >= m->p) sum -= m->p;
+    }
+    return sum;
+}
+
+#endif // POLY_MODULAR_H
@@ -1,17 +1,93 @@
-#define _POSIX_C_SOURCE 199309L
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
 #include <sys/time.h>
 #include <time.h>
 #include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#include "poly_dispatch.h"
+#include "poly_modular.h"
+#include "poly_io.h"
+#include "counter_rng.h"
 
 #define SEED 2
+#define STREAM_POLY1 0        // Counter RNG stream of each generated buffer
+#define STREAM_POLY2 1
+#define STREAM_BATCH 2
+#define STREAM_SPARSE 3       // Two streams (exponents, coefficients) per sparse operand
+#define COEFF_MAX 10          // Coefficients are drawn from [-COEFF_MAX, COEFF_MAX] \ {0}
+#define KARATSUBA_CUTOFF 64   // Below this length Karatsuba falls back to the per-k kernel
+#define TOOM3_CUTOFF 96       // Below this length Toom-3 falls back to the 64-bit schoolbook kernel
+#define PROFILE_PATH "poly_mult_1a.profile"
+#define DYNAMIC_CHUNK 256     // Output coefficients claimed per grab in the dynamic partition
+#define DEFAULT_L2_BYTES (1024 * 1024)  // Assumed L2 size when it cannot be detected
+#define TILE_MIN 64
+#define TILE_MAX (1 << 20)
+#define BATCH_GRAIN 64        // Jobs claimed per grab by the pool workers
+#define BATCH_SPAWN_SAMPLE 1000  // Pairs timed with one pthread_create round per product
+#define SPARSE_DENSE_CHECK (1 << 22)  // Up to this degree the sparse product is also checked densely
+#define STREAM_BLOCK 4096     // Output coefficients handed to the writer at a time (-o, naive path)
+
+// NTT-friendly primes p = c*2^k + 1 with primitive root 3 (CRT modulus ~7.9e16)
+#define NTT_P1 167772161ULL   // 5*2^25 + 1
+#define NTT_P2 469762049ULL   // 7*2^26 + 1
+#define NTT_ROOT 3ULL
+#define NTT_MAX_LOG 25
+
+// Algorithms that can be selected from the command line
+#define ALG_NAIVE     POLY_ALG_SCHOOLBOOK   // Per-k convolution, equal slices of k per thread
+#define ALG_KARATSUBA POLY_ALG_KARATSUBA    // Parallel Karatsuba recursion
+#define ALG_TOOM3     POLY_ALG_TOOM3        // Parallel Toom-3 recursion (64-bit internally)
+#define ALG_NTT       POLY_ALG_TRANSFORM    // Two-prime NTT with pthreads butterflies
+#define ALG_AUTO      (POLY_ALG_COUNT)      // Dispatcher: pick from the calibrated profile
+#define ALG_CALIBRATE (POLY_ALG_COUNT + 1)  // Measure crossovers and write the profile
+
+// How thread_multiply() splits the output coefficients k between threads
+#define PART_EQUAL    0   // Equal number of k per thread
+#define PART_BALANCED 1   // Equal cumulative inner-loop cost per thread
+#define PART_DYNAMIC  2   // Chunks of k claimed from an atomic counter
+
+// Dot-product kernels behind the per-k convolution, picked at runtime from CPUID
+#define KERNEL_SCALAR 0
+#define KERNEL_AVX2   1
+#define KERNEL_AVX512 2
+#define KERNEL_AUTO   3
 
 int *poly1, *poly2;
-int *serial_mult_result, *parallel_mult_result;
+int *poly2_rev;               // poly2 reversed, shared by the threads of parallel_multiply()
+long long *serial_mult_result, *parallel_mult_result;
 int n; // Degree of the polynomials
 int num_threads;
+uint64_t rng_seed;            // Seed of the counter RNG that generates every input
+int algorithm = ALG_NAIVE;
+int karatsuba_cutoff = KARATSUBA_CUTOFF;
+int coeff_max = COEFF_MAX;
+long long operand_max = COEFF_MAX; // Largest |coefficient| of the operands (measured with -i)
+int partition = PART_EQUAL;
+int dynamic_chunk = DYNAMIC_CHUNK;
+int *partition_bounds;        // Static partitions: thread t owns [bounds[t], bounds[t+1])
+atomic_int next_k;            // Dynamic partition: next unclaimed output coefficient
+double *thread_busy;          // Per-thread time spent in thread_multiply() (last run)
+int tile_size = 0;            // Tiled convolution: k/i block size, 0 = untiled, -1 = from the cache size
+long l2_bytes;                // Detected L2 size used to derive tile_size
+int batch_pairs = 0;          // -b: number of independent pairs to multiply, 0 = single product
+struct poly_mod modulus;      // -m: coefficients in Z_p; modulus.p == 0 means plain integers
+uint64_t *mod_poly1, *mod_poly2;           // Residues in [0, p) used instead of poly1/poly2
+uint64_t *mod_poly1_mont, *mod_poly2_rev;  // Montgomery form of poly1, poly2 reversed (parallel_multiply())
+long sparse_terms = 0;        // -S: nonzero terms per sparse operand, 0 = dense inputs
+char *input_files;            // -i a.bin,b.bin: operands mmap'd from polynomial files
+char *generate_files;         // -g a.bin,b.bin: write the random operands to polynomial files
+char *output_file;            // -o c.bin: stream the parallel product to a polynomial file
+struct poly_mapping poly1_map, poly2_map;
+struct poly_writer *stream_writer;  // Set while the parallel product is being streamed
 
 
 // Function to get the current time in seconds
@@ -32,75 +108,366 @@ static int compare_results(void) {
     return mismatches;
 }
 
+// Random coefficients from -rand_max to rand_max, excluding the 0
+struct coeff_fill {
+    int *dst;
+    uint64_t key;
+    int rand_max;
+};
+
+static void coeff_fill_range(void *ctx, long start, long end) {
+    struct coeff_fill *f = (struct coeff_fill *)ctx;
+    for (long i = start; i < end; ++i) {
+        f->dst[i] = crng_nonzero_in(f->key, i, f->rand_max);
+    }
+}
+
+// Fill dst[0 .. count) from the given stream on num_threads threads (same values for any thread count)
+static void random_coeffs(int *dst, long count, uint64_t stream, int rand_max) {
+    struct coeff_fill f = { dst, crng_key(rng_seed, stream), rand_max };
+    crng_parallel_fill(count, num_threads, coeff_fill_range, &f);
+}
+
 // Initialize the polynomials with random coefficients
 void initialize_polynomials(int rand_max){
 
-    for(int i = 0; i <= n; i++){
-        // Get a random coefficient from -rand_max to rand_max, excluding the 0
-        do {
-            poly1[i] = (rand() % ((2*rand_max)+1)) - rand_max;
-        } while (poly1[i] == 0);
-        do {
-            poly2[i] = (rand() % ((2*rand_max)+1)) - rand_max;
-        } while (poly2[i] == 0);
-    }    
+    random_coeffs(poly1, n + 1, STREAM_POLY1, rand_max);
+    random_coeffs(poly2, n + 1, STREAM_POLY2, rand_max);
 
     return;
 }
 
+// -------- Dot-product kernels --------
+// sum x[i]*y[i] over count ints, accumulated in 64 bits so large degrees cannot overflow.
+// The SIMD versions widen each 32-bit product into a 64-bit lane (mul_epi32 on the even
+// lanes, then on the odd lanes shifted down) and sum the lanes once at the end.
+static long long dot_scalar(const int *x, const int *y, int count) {
+    long long sum = 0;
+    for (int i = 0; i < count; ++i) {
+        sum += (long long)x[i] * y[i];
+    }
+    return sum;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static long long dot_avx2(const int *x, const int *y, int count) {
+    __m256i even = _mm256_setzero_si256();
+    __m256i odd = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i vx = _mm256_loadu_si256((const __m256i *)(x + i));
+        __m256i vy = _mm256_loadu_si256((const __m256i *)(y + i));
+        even = _mm256_add_epi64(even, _mm256_mul_epi32(vx, vy));
+        odd = _mm256_add_epi64(odd, _mm256_mul_epi32(_mm256_srli_epi64(vx, 32), _mm256_srli_epi64(vy, 32)));
+    }
+    __m256i acc = _mm256_add_epi64(even, odd);
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    long long sum = _mm_cvtsi128_si64(half) + _mm_extract_epi64(half, 1);
+    for (; i < count; ++i) {
+        sum += (long long)x[i] * y[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+static long long dot_avx512(const int *x, const int *y, int count) {
+    __m512i even = _mm512_setzero_si512();
+    __m512i odd = _mm512_setzero_si512();
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i vx = _mm512_loadu_si512((const void *)(x + i));
+        __m512i vy = _mm512_loadu_si512((const void *)(y + i));
+        even = _mm512_add_epi64(even, _mm512_mul_epi32(vx, vy));
+        odd = _mm512_add_epi64(odd, _mm512_mul_epi32(_mm512_srli_epi64(vx, 32), _mm512_srli_epi64(vy, 32)));
+    }
+    long long sum = _mm512_reduce_add_epi64(_mm512_add_epi64(even, odd));
+    for (; i < count; ++i) {
+        sum += (long long)x[i] * y[i];
+    }
+    return sum;
+}
+#endif
+
+static long long (*dot_kernel)(const int *, const int *, int) = dot_scalar;
+static const char *kernel_names[] = { "scalar", "avx2", "avx512" };
+int kernel = KERNEL_AUTO;
+
+// Resolve KERNEL_AUTO (or a forced kernel the CPU lacks) from CPUID and install it
+static void select_kernel() {
+    int best = KERNEL_SCALAR;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) best = KERNEL_AVX2;
+    if (__builtin_cpu_supports("avx512f")) best = KERNEL_AVX512;
+#endif
+    if (kernel == KERNEL_AUTO || kernel > best) kernel = best;
+
+    switch (kernel) {
+#ifdef HAVE_X86_SIMD
+        case KERNEL_AVX512: dot_kernel = dot_avx512; break;
+        case KERNEL_AVX2:   dot_kernel = dot_avx2; break;
+#endif
+        default:            dot_kernel = dot_scalar; break;
+    }
+}
+
 // Serial Polynomial Multiplication
 void serial_polynomial_multiplication() {
     for (int i=0; i<=n; i++){
         for (int j=0; j<=n; j++){
-            serial_mult_result[i+j] += poly1[i] * poly2[j];
+            serial_mult_result[i+j] += (long long)poly1[i] * poly2[j];
         }
     }
 }
 
 
-// TODO: Check
-void serial_polynomial_multiplication_k() {
+// dst[j] = src[len-1-j]
+static void reverse_copy(const int *src, int len, int *dst) {
+    for (int j = 0; j < len; ++j) {
+        dst[j] = src[len - 1 - j];
+    }
+}
+
+// Per-k convolution kernel: out[k] for k in [k_start, k_end) of two polynomials
+// with len coefficients each (degree len-1). b is passed reversed (brev[j] = b[deg-j]),
+// so b[k-i] = brev[deg-k+i] and every coefficient is a forward dot product.
+static void convolve_range(const int *a, const int *brev, int len, long long *out, int k_start, int k_end) {
+    int deg = len - 1;
+    for (int k = k_start; k < k_end; ++k) {
+        int i_min = (k - deg > 0) ? (k - deg) : 0;
+        int i_max = (k < deg) ? k : deg;
+        out[k] = dot_kernel(a + i_min, brev + (deg - k + i_min), i_max - i_min + 1); // single store
+    }
+}
+
+// -------- Cache-blocked convolution --------
+// Same result as convolve_range(), but [k_start, k_end) is processed in blocks of
+// tile_size output coefficients, and each block accumulates one i-block at a time.
+// A (k-block, i-block) tile touches tile_size ints of a, about 2*tile_size ints of brev
+// and tile_size long longs of out, so all three stay cache-resident while it runs.
+static void convolve_range_tiled(const int *a, const int *brev, int len, long long *out, int k_start, int k_end) {
+    int deg = len - 1;
+    for (int kb = k_start; kb < k_end; kb += tile_size) {
+        int ke = (kb + tile_size < k_end) ? kb + tile_size : k_end;
+        int i_lo = (kb - deg > 0) ? (kb - deg) : 0;
+        int i_hi = (ke - 1 < deg) ? ke - 1 : deg;
+
+        for (int k = kb; k < ke; ++k) out[k] = 0;
+        for (int ib = i_lo; ib <= i_hi; ib += tile_size) {
+            int ie = (ib + tile_size - 1 < i_hi) ? ib + tile_size - 1 : i_hi;
+            for (int k = kb; k < ke; ++k) {
+                int i_min = (k - deg > ib) ? (k - deg) : ib;
+                int i_max = (k < ie) ? k : ie;
+                if (i_min > i_max) continue;
+                out[k] += dot_kernel(a + i_min, brev + (deg - k + i_min), i_max - i_min + 1);
+            }
+        }
+    }
+}
+
+// L2 size from sysconf, then sysfs, then DEFAULT_L2_BYTES
+static long detect_l2_bytes() {
+    long size = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (size <= 0) {
+        FILE *file = fopen("/sys/devices/system/cpu/cpu0/cache/index2/size", "r");
+        if (file) {
+            char unit = 0;
+            if (fscanf(file, "%ld%c", &size, &unit) >= 1) {
+                if (unit == 'K') size *= 1024;
+                else if (unit == 'M') size *= 1024 * 1024;
+            }
+            fclose(file);
+        }
+    }
+    return (size > 0) ? size : DEFAULT_L2_BYTES;
+}
+
+// A tile uses ~20 bytes per coefficient (4 for a, 8 for brev, 8 for out); size it to half of L2
+static void select_tile_size() {
+    if (tile_size >= 0) return;
+    l2_bytes = detect_l2_bytes();
+    tile_size = (int)(l2_bytes / (2 * 20)) & ~(TILE_MIN - 1);
+    if (tile_size < TILE_MIN) tile_size = TILE_MIN;
+    if (tile_size > TILE_MAX) tile_size = TILE_MAX;
+}
+
+// -------- Modular coefficients --------
+// Same per-k loop as convolve_range(), in Z_p: a in Montgomery form, b reversed and plain,
+// so each poly_mod_dot() returns the coefficient already reduced and out of Montgomery form.
+static void mod_convolve_range(const uint64_t *a_mont, const uint64_t *brev, int len, long long *out, int k_start, int k_end) {
+    int deg = len - 1;
+    for (int k = k_start; k < k_end; ++k) {
+        int i_min = (k - deg > 0) ? (k - deg) : 0;
+        int i_max = (k < deg) ? k : deg;
+        out[k] = (long long)poly_mod_dot(&modulus, a_mont + i_min, brev + (deg - k + i_min), i_max - i_min + 1);
+    }
+}
+
+// Residues in [0, p)
+struct mod_fill {
+    uint64_t *dst;
+    uint64_t key;
+};
+
+static void mod_fill_range(void *ctx, long start, long end) {
+    struct mod_fill *f = (struct mod_fill *)ctx;
+    for (long i = start; i < end; ++i) {
+        f->dst[i] = crng_below(f->key, i, modulus.p);
+    }
+}
+
+void initialize_mod_polynomials() {
+    mod_poly1 = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+    mod_poly2 = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+    struct mod_fill f1 = { mod_poly1, crng_key(rng_seed, STREAM_POLY1) };
+    struct mod_fill f2 = { mod_poly2, crng_key(rng_seed, STREAM_POLY2) };
+    crng_parallel_fill(n + 1, num_threads, mod_fill_range, &f1);
+    crng_parallel_fill(n + 1, num_threads, mod_fill_range, &f2);
+}
+
+// Reference for the modular path: schoolbook with a full reduction after every multiply
+void serial_mod_multiplication() {
+    uint64_t p = modulus.p;
     for (int k = 0; k <= 2*n; ++k) {
         int i_min = (k - n > 0) ? (k - n) : 0;
         int i_max = (k < n) ? k : n;
-        int sum = 0;
+        uint64_t sum = 0;
         for (int i = i_min; i <= i_max; ++i) {
-            sum += poly1[i] * poly2[k - i];
+            sum += poly_mod_mulmod(mod_poly1[i], mod_poly2[k - i], p);
+            if (sum >= p) sum -= p;
         }
-        serial_mult_result[k] = sum; // single store
+        serial_mult_result[k] = (long long)sum;
     }
 }
 
+// Operands of the threaded modular path, built once before the threads start
+static void prepare_mod_operands() {
+    mod_poly1_mont = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+    mod_poly2_rev = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+    for (int i = 0; i <= n; ++i) {
+        mod_poly1_mont[i] = poly_mod_to_mont(&modulus, mod_poly1[i]);
+        mod_poly2_rev[i] = mod_poly2[n - i];
+    }
+}
+
+// Kernel used by the threaded naive path: modular, else tiled when a tile size is set
+static void convolve_slice(int k_start, int k_end) {
+    if (modulus.p) {
+        mod_convolve_range(mod_poly1_mont, mod_poly2_rev, n + 1, parallel_mult_result, k_start, k_end);
+    } else if (tile_size > 0) {
+        convolve_range_tiled(poly1, poly2_rev, n + 1, parallel_mult_result, k_start, k_end);
+    } else {
+        convolve_range(poly1, poly2_rev, n + 1, parallel_mult_result, k_start, k_end);
+    }
+}
+
+// Reference product for compare_results(): the per-k loop with dot_scalar(), never the
+// dispatched kernel, so a wrong AVX2/AVX-512 kernel shows up as a mismatch
+void serial_polynomial_multiplication_k() {
+    int *rev = (int *)malloc((n + 1) * sizeof(int));
+    reverse_copy(poly2, n + 1, rev);
+    for (int k = 0; k <= 2*n; ++k) {
+        int i_min = (k - n > 0) ? (k - n) : 0;
+        int i_max = (k < n) ? k : n;
+        serial_mult_result[k] = dot_scalar(poly1 + i_min, rev + (n - k + i_min), i_max - i_min + 1);
+    }
+    free(rev);
+}
+
 
 
 
+// convolve_slice() in STREAM_BLOCK pieces, each handed to the writer as soon as it is final
+static void convolve_and_stream(int k_start, int k_end) {
+    if (!stream_writer) {
+        convolve_slice(k_start, k_end);
+        return;
+    }
+    for (int ks = k_start; ks < k_end; ks += STREAM_BLOCK) {
+        int ke = (k_end - ks > STREAM_BLOCK) ? ks + STREAM_BLOCK : k_end;
+        convolve_slice(ks, ke);
+        poly_writer_submit(stream_writer, parallel_mult_result + ks, ks, ke - ks);
+    }
+}
+
 // Thread function for polynomial multiplication
 void *thread_multiply(void *rank) {
     long t = (long)rank;
+    double start_time = get_time();
 
-    int total = 2*n + 1;
-    int chunk = (total + num_threads - 1) / num_threads; // ceil
-    int start_k = t * chunk;
-    int end_k   = start_k + chunk;
-    if (end_k > total) end_k = total;
-
-    for (int k = start_k; k < end_k; ++k) {
-        int i_min = (k - n > 0) ? (k - n) : 0;
-        int i_max = (k < n) ? k : n;
-        int sum = 0;
-        for (int i = i_min; i <= i_max; ++i) {
-            sum += poly1[i] * poly2[k - i];
+    if (partition == PART_DYNAMIC) {
+        int total = 2*n + 1;
+        int start_k;
+        while ((start_k = atomic_fetch_add(&next_k, dynamic_chunk)) < total) {
+            int end_k = start_k + dynamic_chunk;
+            if (end_k > total) end_k = total;
+            convolve_and_stream(start_k, end_k);
         }
-        parallel_mult_result[k] = sum; 
+    } else {
+        convolve_and_stream(partition_bounds[t], partition_bounds[t + 1]);
     }
 
+    thread_busy[t] = get_time() - start_time;
     return NULL;
 }
 
+// Inner-loop length of output coefficient k: i_max - i_min + 1
+static long long k_cost(int k) {
+    int i_min = (k - n > 0) ? (k - n) : 0;
+    int i_max = (k < n) ? k : n;
+    return i_max - i_min + 1;
+}
+
+// Fill partition_bounds for the static partitions
+static void compute_partition() {
+    int total = 2*n + 1;
+
+    if (partition == PART_BALANCED) {
+        // The costs form a triangle summing to (n+1)^2: cut where the running sum
+        // crosses each t/num_threads share of it
+        long long total_cost = (long long)(n + 1) * (n + 1);
+        long long acc = 0;
+        int t = 1;
+        partition_bounds[0] = 0;
+        for (int k = 0; k < total && t < num_threads; ++k) {
+            acc += k_cost(k);
+            while (t < num_threads && acc * num_threads >= total_cost * t) {
+                partition_bounds[t++] = k + 1;
+            }
+        }
+        while (t <= num_threads) partition_bounds[t++] = total;
+    } else {
+        int chunk = (total + num_threads - 1) / num_threads; // ceil
+        for (int t = 0; t <= num_threads; ++t) {
+            long bound = (long)t * chunk;
+            partition_bounds[t] = (bound > total) ? total : (int)bound;
+        }
+    }
+}
+
 // Parallel Polynomial Multiplication (main thread function)
 void parallel_multiply() {
 
     pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    partition_bounds = (int *)malloc((num_threads + 1) * sizeof(int));
+    free(thread_busy);
+    thread_busy = (double *)calloc(num_threads, sizeof(double));
+    if (modulus.p) {
+        prepare_mod_operands();
+    } else {
+        poly2_rev = (int *)malloc((n + 1) * sizeof(int));
+        reverse_copy(poly2, n + 1, poly2_rev);
+    }
+
+    if (partition == PART_DYNAMIC) {
+        atomic_store(&next_k, 0);
+    } else {
+        compute_partition();
+    }
 
     long thread;
 
@@ -114,61 +481,1426 @@ void parallel_multiply() {
     }
 
     free(threads);
+    free(partition_bounds);
+    free(poly2_rev);
+    free(mod_poly1_mont);
+    free(mod_poly2_rev);
+    poly2_rev = NULL;
+    mod_poly1_mont = mod_poly2_rev = NULL;
+}
+
+// Per-thread busy times of the last parallel_multiply() and max/mean imbalance
+static void print_thread_busy() {
+    double max = 0, sum = 0;
+    printf("\nPer-thread busy time:");
+    for (int t = 0; t < num_threads; ++t) {
+        printf("\n  thread %d: %.10f seconds", t, thread_busy[t]);
+        sum += thread_busy[t];
+        if (thread_busy[t] > max) max = thread_busy[t];
+    }
+    printf("\nLoad imbalance (max/mean): %.3f\n", (sum > 0) ? max * num_threads / sum : 1.0);
+}
+
+
+// -------- Karatsuba --------
+// Both operands have m coefficients and the product has 2m-1. The split point is
+// h = ceil(m/2), so a = a0 + x^h a1 with len(a0) = h and len(a1) = l = m - h:
+//   z0 = a0*b0, z2 = a1*b1, z1 = (a0+a1)(b0+b1) - z0 - z2
+//   r  = z0 + x^h z1 + x^2h z2
+// z0 and z2 are written straight into the disjoint halves of r, z1 goes to scratch.
+// Operand sums stay int (they grow 2x per level, poly_operand_limit() rejects inputs
+// large enough to overflow them); products are 64-bit.
+
+// Scratch needed by karatsuba_serial() for operands of length m: ints for sa, sb and
+// the reversed base-case operand, long longs for z1
+static void karatsuba_scratch_size(int m, long *ints, long *longs) {
+    *ints = 0;
+    *longs = 0;
+    while (m > karatsuba_cutoff) {
+        int h = (m + 1) / 2;
+        *ints += 2L*h;       // sa, sb
+        *longs += 2L*h - 1;  // z1
+        m = h;               // the z1 sub-product is the largest one
+    }
+    *ints += m;
+}
+
+// Form the operand sums a0+a1, b0+b1 (length h) into sa, sb
+static void karatsuba_sums(const int *a, const int *b, int h, int l, int *sa, int *sb) {
+    for (int i = 0; i < h; ++i) {
+        sa[i] = a[i] + ((i < l) ? a[h + i] : 0);
+        sb[i] = b[i] + ((i < l) ? b[h + i] : 0);
+    }
+}
+
+// r += x^h (z1 - z0 - z2), with z0 and z2 already stored in r
+static void karatsuba_combine(long long *r, long long *z1, int h, int l) {
+    for (int i = 0; i < 2*h - 1; ++i) z1[i] -= r[i];
+    for (int i = 0; i < 2*l - 1; ++i) z1[i] -= r[2*h + i];
+    for (int i = 0; i < 2*h - 1; ++i) r[h + i] += z1[i];
+}
+
+static void karatsuba_serial(const int *a, const int *b, int m, long long *r, int *iscratch, long long *lscratch) {
+    if (m <= karatsuba_cutoff) {
+        reverse_copy(b, m, iscratch);
+        convolve_range(a, iscratch, m, r, 0, 2*m - 1);
+        return;
+    }
+    int h = (m + 1) / 2;
+    int l = m - h;
+    int *sa = iscratch;
+    int *sb = sa + h;
+    int *irest = sb + h;
+    long long *z1 = lscratch;
+    long long *lrest = z1 + 2*h - 1;
+
+    karatsuba_serial(a, b, h, r, irest, lrest);                 // z0 -> r[0 .. 2h-2]
+    r[2*h - 1] = 0;
+    karatsuba_serial(a + h, b + h, l, r + 2*h, irest, lrest);   // z2 -> r[2h .. 2m-2]
+    karatsuba_sums(a, b, h, l, sa, sb);
+    karatsuba_serial(sa, sb, h, z1, irest, lrest);
+    karatsuba_combine(r, z1, h, l);
+}
+
+// One node of the parallel recursion, owning a budget of threads
+struct karatsuba_task {
+    const int *a;
+    const int *b;
+    int m;
+    long long *r;
+    int threads;
+};
+
+void *karatsuba_task_run(void *arg) {
+    struct karatsuba_task *task = (struct karatsuba_task *)arg;
+    int m = task->m;
+
+    // Out of threads (or too small to split): finish the subtree serially
+    if (task->threads <= 1 || m <= karatsuba_cutoff) {
+        long ints, longs;
+        karatsuba_scratch_size(m, &ints, &longs);
+        int *iscratch = (int *)malloc(ints * sizeof(int));
+        long long *lscratch = (long long *)malloc((longs + 1) * sizeof(long long));
+        karatsuba_serial(task->a, task->b, m, task->r, iscratch, lscratch);
+        free(iscratch);
+        free(lscratch);
+        return NULL;
+    }
+
+    int h = (m + 1) / 2;
+    int l = m - h;
+    int *sa = (int *)malloc(h * sizeof(int));
+    int *sb = (int *)malloc(h * sizeof(int));
+    long long *z1 = (long long *)malloc((2*h - 1) * sizeof(long long));
+    karatsuba_sums(task->a, task->b, h, l, sa, sb);
+    task->r[2*h - 1] = 0;
+
+    // The three sub-products are independent and split the thread budget
+    struct karatsuba_task sub[3] = {
+        { task->a,     task->b,     h, task->r,         0 },   // z0
+        { task->a + h, task->b + h, l, task->r + 2*h,   0 },   // z2
+        { sa,          sb,          h, z1,              0 },   // z1
+    };
+    pthread_t workers[2];
+    int spawned;
+
+    if (task->threads >= 3) {
+        sub[0].threads = task->threads / 3;
+        sub[1].threads = task->threads / 3;
+        sub[2].threads = task->threads - 2 * (task->threads / 3);
+        spawned = 2;
+    } else {
+        // Two threads: z0 on a new thread, z2 and z1 in this one
+        sub[0].threads = sub[1].threads = sub[2].threads = 1;
+        spawned = 1;
+    }
+
+    for (int s = 0; s < spawned; ++s) {
+        pthread_create(&workers[s], NULL, karatsuba_task_run, &sub[s]);
+    }
+    for (int s = spawned; s < 3; ++s) {
+        karatsuba_task_run(&sub[s]);
+    }
+    for (int s = 0; s < spawned; ++s) {
+        pthread_join(workers[s], NULL);
+    }
+
+    karatsuba_combine(task->r, z1, h, l);
+
+    free(sa);
+    free(sb);
+    free(z1);
+    return NULL;
+}
+
+// Parallel Karatsuba multiplication (main thread function)
+void parallel_karatsuba() {
+    struct karatsuba_task root = { poly1, poly2, n + 1, parallel_mult_result, num_threads };
+    karatsuba_task_run(&root);
+}
+
+
+// -------- Toom-3 --------
+// Operands are split in three parts of k = ceil(m/3) coefficients, evaluated at
+// 0, 1, -1, -2 and infinity, multiplied pointwise and interpolated (Bodrato's sequence).
+// Evaluation grows coefficients by up to 7x per level, so the recursion works on
+// long long copies and stops early if the next level could overflow 64 bits.
+
+// Plain 64-bit schoolbook product of two length-m operands
+static void schoolbook_ll(const long long *a, const long long *b, int m, long long *r) {
+    for (int k = 0; k < 2*m - 1; ++k) {
+        int i_min = (k - m + 1 > 0) ? (k - m + 1) : 0;
+        int i_max = (k < m - 1) ? k : m - 1;
+        long long sum = 0;
+        for (int i = i_min; i <= i_max; ++i) {
+            sum += a[i] * b[k - i];
+        }
+        r[k] = sum;
+    }
+}
+
+// bound is the largest coefficient magnitude of the operands
+static int toom3_fits(double bound, int k) {
+    double eval = 7.0 * bound;
+    return eval * eval * (double)k * 4.0 < 4.0e18;
+}
+
+// Evaluate the three parts of a at 1, -1 and -2 into e (3 arrays of k)
+static void toom3_evaluate(const long long *a, int k, int l, long long *e) {
+    long long *p1 = e, *pm1 = e + k, *pm2 = e + 2*k;
+    for (int i = 0; i < k; ++i) {
+        long long a0 = a[i], a1 = a[k + i], a2 = (i < l) ? a[2*k + i] : 0;
+        long long p0 = a0 + a2;
+        p1[i]  = p0 + a1;
+        pm1[i] = p0 - a1;
+        pm2[i] = (pm1[i] + a2) * 2 - a0;
+    }
+}
+
+// prod holds r(0), r(1), r(-1), r(-2), r(inf) as 5 arrays of 2k-1 (r(inf) uses 2l-1)
+static void toom3_interpolate(long long *prod, int k, int l, int m, long long *r) {
+    int plen = 2*k - 1;
+    long long *r0 = prod, *r1 = prod + plen, *rm1 = prod + 2*plen, *rm2 = prod + 3*plen, *rinf = prod + 4*plen;
+
+    for (int i = 0; i < plen; ++i) {
+        long long inf = (i < 2*l - 1) ? rinf[i] : 0;
+        long long c3 = (rm2[i] - r1[i]) / 3;
+        long long c1 = (r1[i] - rm1[i]) / 2;
+        long long c2 = rm1[i] - r0[i];
+        c3 = (c2 - c3) / 2 + 2*inf;
+        c2 = c2 + c1 - inf;
+        c1 = c1 - c3;
+        r1[i] = c1;
+        rm1[i] = c2;
+        rm2[i] = c3;
+    }
+
+    int rlen = 2*m - 1;
+    memset(r, 0, rlen * sizeof(long long));
+    for (int i = 0; i < plen; ++i) {
+        r[i] += r0[i];
+        if (k + i < rlen) r[k + i] += r1[i];
+        if (2*k + i < rlen) r[2*k + i] += rm1[i];
+        if (3*k + i < rlen) r[3*k + i] += rm2[i];
+    }
+    for (int i = 0; i < 2*l - 1; ++i) r[4*k + i] += rinf[i];
+}
+
+static void toom3_serial(const long long *a, const long long *b, int m, long long *r, double bound) {
+    int k = (m + 2) / 3;
+    int l = m - 2*k;
+    if (m <= TOOM3_CUTOFF || l < 1 || !toom3_fits(bound, k)) {
+        schoolbook_ll(a, b, m, r);
+        return;
+    }
+    int plen = 2*k - 1;
+    long long *ea = (long long *)malloc(3 * k * sizeof(long long));
+    long long *eb = (long long *)malloc(3 * k * sizeof(long long));
+    long long *prod = (long long *)malloc(5 * plen * sizeof(long long));
+    toom3_evaluate(a, k, l, ea);
+    toom3_evaluate(b, k, l, eb);
+
+    toom3_serial(a, b, k, prod, bound);
+    toom3_serial(ea, eb, k, prod + plen, 3 * bound);
+    toom3_serial(ea + k, eb + k, k, prod + 2*plen, 3 * bound);
+    toom3_serial(ea + 2*k, eb + 2*k, k, prod + 3*plen, 7 * bound);
+    toom3_serial(a + 2*k, b + 2*k, l, prod + 4*plen, bound);
+    toom3_interpolate(prod, k, l, m, r);
+
+    free(ea);
+    free(eb);
+    free(prod);
+}
+
+// One node of the parallel Toom-3 recursion, owning a budget of threads
+struct toom3_task {
+    const long long *a;
+    const long long *b;
+    int m;
+    long long *r;
+    double bound;
+    int threads;
+};
+
+void *toom3_task_run(void *arg) {
+    struct toom3_task *task = (struct toom3_task *)arg;
+    int m = task->m;
+    int k = (m + 2) / 3;
+    int l = m - 2*k;
+
+    if (task->threads <= 1 || m <= TOOM3_CUTOFF || l < 1 || !toom3_fits(task->bound, k)) {
+        toom3_serial(task->a, task->b, m, task->r, task->bound);
+        return NULL;
+    }
+
+    int plen = 2*k - 1;
+    long long *ea = (long long *)malloc(3 * k * sizeof(long long));
+    long long *eb = (long long *)malloc(3 * k * sizeof(long long));
+    long long *prod = (long long *)malloc(5 * plen * sizeof(long long));
+    toom3_evaluate(task->a, k, l, ea);
+    toom3_evaluate(task->b, k, l, eb);
+
+    // The five pointwise products are independent and split the thread budget
+    double bound = task->bound;
+    struct toom3_task sub[5] = {
+        { task->a,         task->b,         k, prod,            bound,     1 },
+        { ea,              eb,              k, prod + plen,     3 * bound, 1 },
+        { ea + k,          eb + k,          k, prod + 2*plen,   3 * bound, 1 },
+        { ea + 2*k,        eb + 2*k,        k, prod + 3*plen,   7 * bound, 1 },
+        { task->a + 2*k,   task->b + 2*k,   l, prod + 4*plen,   bound,     1 },
+    };
+    pthread_t workers[4];
+    int spawned;
+
+    if (task->threads >= 5) {
+        for (int s = 0; s < 5; ++s) {
+            sub[s].threads = task->threads / 5 + (s < task->threads % 5);
+        }
+        spawned = 4;
+    } else {
+        // Fewer threads than products: the rest run one after another in this thread
+        spawned = task->threads - 1;
+    }
+
+    for (int s = 0; s < spawned; ++s) {
+        pthread_create(&workers[s], NULL, toom3_task_run, &sub[s]);
+    }
+    for (int s = spawned; s < 5; ++s) {
+        toom3_task_run(&sub[s]);
+    }
+    for (int s = 0; s < spawned; ++s) {
+        pthread_join(workers[s], NULL);
+    }
+
+    toom3_interpolate(prod, k, l, m, task->r);
+
+    free(ea);
+    free(eb);
+    free(prod);
+    return NULL;
+}
+
+// Parallel Toom-3 multiplication (main thread function)
+void parallel_toom3() {
+    int m = n + 1;
+    long long *a = (long long *)malloc(m * sizeof(long long));
+    long long *b = (long long *)malloc(m * sizeof(long long));
+    for (int i = 0; i < m; ++i) {
+        a[i] = poly1[i];
+        b[i] = poly2[i];
+    }
+
+    struct toom3_task root = { a, b, m, parallel_mult_result, (double)operand_max, num_threads };
+    toom3_task_run(&root);
+
+    free(a);
+    free(b);
+}
+
+
+// -------- Number-theoretic transform --------
+// The product is computed modulo two NTT primes at once and recombined with CRT.
+// Every thread owns a slice of each pass and the passes are separated by a barrier.
+struct ntt_context {
+    unsigned long long *fa[2], *fb[2];        // Operands / product, one pair per prime
+    unsigned long long *roots[2][2];          // Twiddles per [prime][inverse]: roots[half + j] = w^j
+    int len;
+    int log_len;
+    pthread_barrier_t barrier;
+};
+static struct ntt_context ntt_ctx;
+static const unsigned long long ntt_primes[2] = { NTT_P1, NTT_P2 };
+
+static unsigned long long mod_pow(unsigned long long base, unsigned long long exp, unsigned long long mod) {
+    unsigned long long result = 1;
+    base %= mod;
+    while (exp > 0) {
+        if (exp & 1) result = result * base % mod;
+        base = base * base % mod;
+        exp >>= 1;
+    }
+    return result;
+}
+
+static unsigned long long *ntt_roots(int len, unsigned long long mod, int invert) {
+    unsigned long long *roots = (unsigned long long *)malloc(len * sizeof(unsigned long long));
+    for (int half = 1; half < len; half <<= 1) {
+        unsigned long long w = mod_pow(NTT_ROOT, (mod - 1) / (2 * half), mod);
+        if (invert) w = mod_pow(w, mod - 2, mod);
+        roots[half] = 1;
+        for (int j = 1; j < half; ++j) roots[half + j] = roots[half + j - 1] * w % mod;
+    }
+    return roots;
+}
+
+// Equal slice [start, end) of total items for thread rank
+static void thread_slice(int total, long rank, int *start, int *end) {
+    int chunk = (total + num_threads - 1) / num_threads;
+    *start = rank * chunk;
+    *end = *start + chunk;
+    if (*start > total) *start = total;
+    if (*end > total) *end = total;
+}
+
+// One transform of a (both primes) by thread rank; the caller has already synchronized
+static void ntt_transform(unsigned long long *a[2], int invert, long rank) {
+    int len = ntt_ctx.len, start, end;
+
+    thread_slice(len, rank, &start, &end);
+    for (int i = start; i < end; ++i) {
+        int j = 0;
+        for (int b = 0; b < ntt_ctx.log_len; ++b) j |= ((i >> b) & 1) << (ntt_ctx.log_len - 1 - b);
+        if (i < j) {
+            for (int p = 0; p < 2; ++p) {
+                unsigned long long tmp = a[p][i];
+                a[p][i] = a[p][j];
+                a[p][j] = tmp;
+            }
+        }
+    }
+    pthread_barrier_wait(&ntt_ctx.barrier);
+
+    thread_slice(len / 2, rank, &start, &end);
+    for (int half = 1; half < len; half <<= 1) {
+        for (int p = 0; p < 2; ++p) {
+            unsigned long long mod = ntt_primes[p];
+            const unsigned long long *roots = ntt_ctx.roots[p][invert];
+            for (int j = start; j < end; ++j) {
+                int k = j & (half - 1);
+                int i = ((j - k) << 1) + k;
+                unsigned long long u = a[p][i];
+                unsigned long long v = a[p][i + half] * roots[half + k] % mod;
+                a[p][i] = (u + v < mod) ? u + v : u + v - mod;
+                a[p][i + half] = (u >= v) ? u - v : u + mod - v;
+            }
+        }
+        pthread_barrier_wait(&ntt_ctx.barrier);
+    }
+}
+
+void *thread_ntt(void *rank) {
+    long t = (long)rank;
+    int len = ntt_ctx.len, start, end;
+    int result_len = 2*n + 1;
+
+    // Load the operands, mapping negative coefficients into [0, p)
+    thread_slice(len, t, &start, &end);
+    for (int i = start; i < end; ++i) {
+        for (int p = 0; p < 2; ++p) {
+            long long mod = (long long)ntt_primes[p];
+            ntt_ctx.fa[p][i] = (i <= n) ? (unsigned long long)((poly1[i] % mod + mod) % mod) : 0;
+            ntt_ctx.fb[p][i] = (i <= n) ? (unsigned long long)((poly2[i] % mod + mod) % mod) : 0;
+        }
+    }
+    pthread_barrier_wait(&ntt_ctx.barrier);
+
+    ntt_transform(ntt_ctx.fa, 0, t);
+    ntt_transform(ntt_ctx.fb, 0, t);
+
+    // Pointwise products (fa and fb slices are only touched by this thread here)
+    for (int i = start; i < end; ++i) {
+        for (int p = 0; p < 2; ++p) {
+            ntt_ctx.fa[p][i] = ntt_ctx.fa[p][i] * ntt_ctx.fb[p][i] % ntt_primes[p];
+        }
+    }
+    pthread_barrier_wait(&ntt_ctx.barrier);
+
+    ntt_transform(ntt_ctx.fa, 1, t);
+
+    // Scale by 1/len and recombine with CRT into signed coefficients
+    unsigned long long len_inv[2] = { mod_pow(len, NTT_P1 - 2, NTT_P1), mod_pow(len, NTT_P2 - 2, NTT_P2) };
+    unsigned long long p1_inv = mod_pow(NTT_P1, NTT_P2 - 2, NTT_P2);
+    unsigned long long modulus = NTT_P1 * NTT_P2;
+    thread_slice(result_len, t, &start, &end);
+    for (int k = start; k < end; ++k) {
+        unsigned long long r1 = ntt_ctx.fa[0][k] * len_inv[0] % NTT_P1;
+        unsigned long long r2 = ntt_ctx.fa[1][k] * len_inv[1] % NTT_P2;
+        unsigned long long diff = (r2 + NTT_P2 - r1 % NTT_P2) % NTT_P2;
+        unsigned long long x = r1 + NTT_P1 * (diff * p1_inv % NTT_P2);
+        parallel_mult_result[k] = (x > modulus / 2) ? (long long)x - (long long)modulus : (long long)x;
+    }
+
+    return NULL;
+}
+
+// Parallel NTT multiplication (main thread function)
+void parallel_ntt() {
+    int len = 1, log_len = 0;
+    while (len < 2*n + 1) {
+        len <<= 1;
+        ++log_len;
+    }
+    if (log_len > NTT_MAX_LOG) {
+        fprintf(stderr, "Degree %d is too large for the NTT primes.\n", n);
+        exit(1);
+    }
+
+    ntt_ctx.len = len;
+    ntt_ctx.log_len = log_len;
+    for (int p = 0; p < 2; ++p) {
+        ntt_ctx.fa[p] = (unsigned long long *)malloc(len * sizeof(unsigned long long));
+        ntt_ctx.fb[p] = (unsigned long long *)malloc(len * sizeof(unsigned long long));
+        ntt_ctx.roots[p][0] = ntt_roots(len, ntt_primes[p], 0);
+        ntt_ctx.roots[p][1] = ntt_roots(len, ntt_primes[p], 1);
+    }
+    pthread_barrier_init(&ntt_ctx.barrier, NULL, num_threads);
+
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    for (long thread = 0; thread < num_threads; thread++) {
+        pthread_create(&threads[thread], NULL, thread_ntt, (void*) thread);
+    }
+    for (long thread = 0; thread < num_threads; thread++) {
+        pthread_join(threads[thread], NULL);
+    }
+    free(threads);
+
+    pthread_barrier_destroy(&ntt_ctx.barrier);
+    for (int p = 0; p < 2; ++p) {
+        free(ntt_ctx.fa[p]);
+        free(ntt_ctx.fb[p]);
+        free(ntt_ctx.roots[p][0]);
+        free(ntt_ctx.roots[p][1]);
+    }
+}
+
+
+// -------- Batched products on a persistent thread pool --------
+// Many independent small products: each job is one (a, b, out) pair of the same or
+// different degrees. The workers are created once and reused for every batch, and claim
+// BATCH_GRAIN jobs at a time from an atomic counter. Degrees up to BATCH_FIXED_MAX use a
+// kernel specialized at compile time (constant trip counts, fully unrolled); everything
+// else goes through karatsuba_serial(), which falls back to the per-k kernel below the cutoff.
+
+struct poly_job {
+    const int *a, *b;     // degree+1 coefficients each
+    long long *out;       // 2*degree+1 coefficients
+    int degree;
+};
+
+// Per-worker scratch for the generic path, grown on demand
+struct batch_scratch {
+    int *ints;
+    long long *longs;
+    long ints_size, longs_size;
+};
+
+#define DEFINE_FIXED_KERNEL(D)                                              \
+static void mult_fixed_##D(const int *a, const int *b, long long *out) {    \
+    long long r[2*(D) + 1] = { 0 };                                         \
+    _Pragma("GCC unroll 64")                                                \
+    for (int i = 0; i <= (D); ++i) {                                        \
+        _Pragma("GCC unroll 64")                                            \
+        for (int j = 0; j <= (D); ++j) r[i + j] += (long long)a[i] * b[j];  \
+    }                                                                       \
+    memcpy(out, r, sizeof(r));                                              \
+}
+
+DEFINE_FIXED_KERNEL(1)  DEFINE_FIXED_KERNEL(2)  DEFINE_FIXED_KERNEL(3)  DEFINE_FIXED_KERNEL(4)
+DEFINE_FIXED_KERNEL(5)  DEFINE_FIXED_KERNEL(6)  DEFINE_FIXED_KERNEL(7)  DEFINE_FIXED_KERNEL(8)
+DEFINE_FIXED_KERNEL(9)  DEFINE_FIXED_KERNEL(10) DEFINE_FIXED_KERNEL(11) DEFINE_FIXED_KERNEL(12)
+DEFINE_FIXED_KERNEL(13) DEFINE_FIXED_KERNEL(14) DEFINE_FIXED_KERNEL(15) DEFINE_FIXED_KERNEL(16)
+DEFINE_FIXED_KERNEL(24) DEFINE_FIXED_KERNEL(31) DEFINE_FIXED_KERNEL(32)
+
+#define BATCH_FIXED_MAX 32
+static void (*const fixed_kernels[BATCH_FIXED_MAX + 1])(const int *, const int *, long long *) = {
+    [1] = mult_fixed_1,   [2] = mult_fixed_2,   [3] = mult_fixed_3,   [4] = mult_fixed_4,
+    [5] = mult_fixed_5,   [6] = mult_fixed_6,   [7] = mult_fixed_7,   [8] = mult_fixed_8,
+    [9] = mult_fixed_9,   [10] = mult_fixed_10, [11] = mult_fixed_11, [12] = mult_fixed_12,
+    [13] = mult_fixed_13, [14] = mult_fixed_14, [15] = mult_fixed_15, [16] = mult_fixed_16,
+    [24] = mult_fixed_24, [31] = mult_fixed_31, [32] = mult_fixed_32,
+};
+
+static void multiply_pair(const struct poly_job *job, struct batch_scratch *scratch) {
+    if (job->degree == 0) {
+        job->out[0] = (long long)job->a[0] * job->b[0];
+        return;
+    }
+    if (job->degree <= BATCH_FIXED_MAX && fixed_kernels[job->degree]) {
+        fixed_kernels[job->degree](job->a, job->b, job->out);
+        return;
+    }
+    long ints, longs;
+    karatsuba_scratch_size(job->degree + 1, &ints, &longs);
+    if (ints > scratch->ints_size) {
+        scratch->ints = (int *)realloc(scratch->ints, ints * sizeof(int));
+        scratch->ints_size = ints;
+    }
+    if (longs > scratch->longs_size) {
+        scratch->longs = (long long *)realloc(scratch->longs, longs * sizeof(long long));
+        scratch->longs_size = longs;
+    }
+    karatsuba_serial(job->a, job->b, job->degree + 1, job->out, scratch->ints, scratch->longs);
+}
+
+struct thread_pool {
+    pthread_t *threads;
+    int size;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;    // a new batch was posted (or shutdown)
+    pthread_cond_t work_done;     // the last worker finished the current batch
+    const struct poly_job *jobs;  // current batch, valid while active > 0
+    int job_count;
+    atomic_int next_job;
+    int generation;               // bumped once per batch
+    int active;                   // workers still inside the current batch
+    int shutdown;
+};
+
+void *pool_worker(void *arg) {
+    struct thread_pool *pool = (struct thread_pool *)arg;
+    struct batch_scratch scratch = { NULL, NULL, 0, 0 };
+    int seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->shutdown) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->shutdown) break;
+        seen = pool->generation;
+        const struct poly_job *jobs = pool->jobs;
+        int count = pool->job_count;
+        pthread_mutex_unlock(&pool->lock);
+
+        int start;
+        while ((start = atomic_fetch_add(&pool->next_job, BATCH_GRAIN)) < count) {
+            int end = (start + BATCH_GRAIN < count) ? start + BATCH_GRAIN : count;
+            for (int j = start; j < end; ++j) multiply_pair(&jobs[j], &scratch);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) pthread_cond_signal(&pool->work_done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    free(scratch.ints);
+    free(scratch.longs);
+    return NULL;
+}
+
+static void pool_create(struct thread_pool *pool, int size) {
+    pool->threads = (pthread_t *)malloc(size * sizeof(pthread_t));
+    pool->size = size;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+    pool->jobs = NULL;
+    pool->job_count = 0;
+    atomic_init(&pool->next_job, 0);
+    pool->generation = 0;
+    pool->active = 0;
+    pool->shutdown = 0;
+    for (int t = 0; t < size; ++t) {
+        pthread_create(&pool->threads[t], NULL, pool_worker, pool);
+    }
+}
+
+static void pool_destroy(struct thread_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (int t = 0; t < pool->size; ++t) {
+        pthread_join(pool->threads[t], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->threads);
+}
+
+// Run every job of the batch on the pool and return once all outputs are written
+static void batch_multiply(struct thread_pool *pool, const struct poly_job *jobs, int count) {
+    pthread_mutex_lock(&pool->lock);
+    pool->jobs = jobs;
+    pool->job_count = count;
+    atomic_store(&pool->next_job, 0);
+    pool->active = pool->size;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->work_ready);
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pool->jobs = NULL;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// -b mode: batch_pairs random pairs of degree n, serial loop vs one pthread_create per
+// product (the old parallel_multiply(), on a sample) vs the persistent pool
+static int run_batch() {
+    long in_len = n + 1, out_len = 2L*n + 1;
+    int *operands = (int *)malloc(2 * batch_pairs * in_len * sizeof(int));
+    long long *serial_out = (long long *)malloc(batch_pairs * out_len * sizeof(long long));
+    long long *pool_out = (long long *)calloc(batch_pairs * out_len, sizeof(long long));
+    struct poly_job *jobs = (struct poly_job *)malloc(batch_pairs * sizeof(struct poly_job));
+    struct poly_job *serial_jobs = (struct poly_job *)malloc(batch_pairs * sizeof(struct poly_job));
+    if (!operands || !serial_out || !pool_out || !jobs || !serial_jobs) {
+        fprintf(stderr, "Not enough memory for %d pairs of degree %d\n", batch_pairs, n);
+        return 1;
+    }
+
+    random_coeffs(operands, 2 * batch_pairs * in_len, STREAM_BATCH, coeff_max);
+    for (int p = 0; p < batch_pairs; ++p) {
+        struct poly_job job = { operands + 2*p*in_len, operands + (2*p + 1)*in_len, pool_out + p*out_len, n };
+        jobs[p] = job;
+        job.out = serial_out + p*out_len;
+        serial_jobs[p] = job;
+    }
+
+    printf("\n === Batched multiplication with a persistent thread pool === \n");
+    printf("Pairs: %d of degree %d\n", batch_pairs, n);
+    printf("Number of threads: %d \n", num_threads);
+    printf("Kernel: %s\n", (n <= BATCH_FIXED_MAX && fixed_kernels[n]) ? "unrolled fixed-degree" : "karatsuba / per-k");
+
+    // --------- Serial loop ---------
+    struct batch_scratch scratch = { NULL, NULL, 0, 0 };
+    double start_time = get_time();
+    for (int p = 0; p < batch_pairs; ++p) multiply_pair(&serial_jobs[p], &scratch);
+    double serial_time = get_time() - start_time;
+    free(scratch.ints);
+    free(scratch.longs);
+
+    // --------- One pthread_create/join round per product ---------
+    int sample = (batch_pairs < BATCH_SPAWN_SAMPLE) ? batch_pairs : BATCH_SPAWN_SAMPLE;
+    int spawn_mismatches = 0;
+    int *saved_poly1 = poly1, *saved_poly2 = poly2;
+    long long *saved_result = parallel_mult_result;
+    start_time = get_time();
+    for (int p = 0; p < sample; ++p) {
+        poly1 = (int *)jobs[p].a;
+        poly2 = (int *)jobs[p].b;
+        parallel_mult_result = jobs[p].out;
+        parallel_multiply();
+    }
+    double spawn_time = get_time() - start_time;
+    for (int p = 0; p < sample; ++p) {
+        if (memcmp(jobs[p].out, serial_jobs[p].out, out_len * sizeof(long long)) != 0) ++spawn_mismatches;
+    }
+    poly1 = saved_poly1;
+    poly2 = saved_poly2;
+    parallel_mult_result = saved_result;
+    memset(pool_out, 0, batch_pairs * out_len * sizeof(long long));
+
+    // --------- Persistent pool ---------
+    struct thread_pool pool;
+    start_time = get_time();
+    pool_create(&pool, num_threads);
+    double startup_time = get_time() - start_time;
+    start_time = get_time();
+    batch_multiply(&pool, jobs, batch_pairs);
+    double pool_time = get_time() - start_time;
+    pool_destroy(&pool);
+
+    printf("\nSerial loop: %.10f seconds, %.2f pairs/second\n", serial_time, batch_pairs / serial_time);
+    printf("Thread per product (first %d pairs): %.10f seconds, %.2f pairs/second\n", sample, spawn_time, sample / spawn_time);
+    printf("Thread pool: %.10f seconds, %.2f pairs/second (startup %.6f seconds)\n", pool_time, batch_pairs / pool_time, startup_time);
+
+    int mismatches = 0;
+    for (int p = 0; p < batch_pairs; ++p) {
+        if (memcmp(jobs[p].out, serial_jobs[p].out, out_len * sizeof(long long)) != 0) ++mismatches;
+    }
+    if (mismatches == 0 && spawn_mismatches == 0) {
+        printf("\nResults match (serial vs parallel).\n");
+    } else {
+        printf("Mismatch in %d pool / %d thread-per-product pairs!\n", mismatches, spawn_mismatches);
+    }
+
+    free(operands);
+    free(serial_out);
+    free(pool_out);
+    free(jobs);
+    free(serial_jobs);
+    free(thread_busy);
+    printf("\n");
+    return 0;
+}
+
+// -------- Sparse polynomials --------
+// A polynomial with few nonzero terms at high degree is a list of (exponent, coefficient)
+// pairs with strictly increasing exponents. The product is formed with Johnson's heap
+// merge: one heap entry per term of a, keyed by the exponent of its next product with b,
+// so the output comes out sorted and like terms are combined as they are popped. Work is
+// O(ta*tb log ta) for ta, tb terms, independent of the degree.
+// Threads split the output exponent range into slices holding about the same number of
+// products; each one runs its own heap over the pairs landing in its slice, and the
+// slices are concatenated in order.
+
+struct sparse_term {
+    long long exp;
+    long long coeff;
+};
+
+struct sparse_poly {
+    long count;
+    struct sparse_term *terms;   // exponents strictly increasing, no zero coefficients
+};
+
+static void sparse_free(struct sparse_poly *p) {
+    free(p->terms);
+    p->terms = NULL;
+    p->count = 0;
+}
+
+// Dense int layout (degree+1 coefficients) -> sparse
+static void sparse_from_dense(const int *dense, int degree, struct sparse_poly *p) {
+    long count = 0;
+    for (int i = 0; i <= degree; ++i) count += (dense[i] != 0);
+    p->terms = (struct sparse_term *)malloc((count > 0 ? count : 1) * sizeof(struct sparse_term));
+    p->count = 0;
+    for (int i = 0; i <= degree; ++i) {
+        if (dense[i] != 0) {
+            p->terms[p->count].exp = i;
+            p->terms[p->count].coeff = dense[i];
+            ++p->count;
+        }
+    }
+}
+
+// Sparse -> dense int layout; all exponents must be <= degree and coefficients must fit in an int
+static void sparse_to_dense(const struct sparse_poly *p, int *dense, int degree) {
+    memset(dense, 0, (degree + 1) * sizeof(int));
+    for (long t = 0; t < p->count; ++t) {
+        dense[p->terms[t].exp] = (int)p->terms[t].coeff;
+    }
+}
+
+static int compare_terms(const void *x, const void *y) {
+    long long ex = ((const struct sparse_term *)x)->exp;
+    long long ey = ((const struct sparse_term *)y)->exp;
+    return (ex > ey) - (ex < ey);
+}
+
+// Up to terms random nonzero terms with exponents in [0, degree] (duplicates are dropped),
+// drawn from streams stream and stream + 1
+static void sparse_random(struct sparse_poly *p, long terms, int degree, int rand_max, uint64_t stream) {
+    if (terms > (long)degree + 1) terms = (long)degree + 1;
+    p->terms = (struct sparse_term *)malloc(terms * sizeof(struct sparse_term));
+    uint64_t exp_key = crng_key(rng_seed, stream), coeff_key = crng_key(rng_seed, stream + 1);
+    for (long t = 0; t < terms; ++t) {
+        p->terms[t].exp = (long long)crng_below(exp_key, t, (uint64_t)degree + 1);
+        p->terms[t].coeff = crng_nonzero_in(coeff_key, t, rand_max);
+    }
+    qsort(p->terms, terms, sizeof(struct sparse_term), compare_terms);
+    long kept = 0;
+    for (long t = 0; t < terms; ++t) {
+        if (kept > 0 && p->terms[kept - 1].exp == p->terms[t].exp) continue;
+        p->terms[kept++] = p->terms[t];
+    }
+    p->count = kept;
+}
+
+// First index of p with exponent >= exp
+static long sparse_lower_bound(const struct sparse_poly *p, long long exp) {
+    long lo = 0, hi = p->count;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (p->terms[mid].exp < exp) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Number of pairs (i, j) with a_i.exp + b_j.exp < exp
+static long long sparse_products_below(const struct sparse_poly *a, const struct sparse_poly *b, long long exp) {
+    long long total = 0;
+    for (long i = 0; i < a->count; ++i) {
+        total += sparse_lower_bound(b, exp - a->terms[i].exp);
+    }
+    return total;
+}
+
+struct sparse_heap_entry {
+    long long exp;    // a_i.exp + b_j.exp
+    long i, j;
+};
+
+static void sparse_heap_down(struct sparse_heap_entry *heap, long size, long pos) {
+    struct sparse_heap_entry e = heap[pos];
+    for (;;) {
+        long child = 2*pos + 1;
+        if (child >= size) break;
+        if (child + 1 < size && heap[child + 1].exp < heap[child].exp) ++child;
+        if (heap[child].exp >= e.exp) break;
+        heap[pos] = heap[child];
+        pos = child;
+    }
+    heap[pos] = e;
+}
+
+static void sparse_push_term(struct sparse_poly *out, long *capacity, long long exp, long long coeff) {
+    if (out->count == *capacity) {
+        *capacity = (*capacity > 0) ? 2 * *capacity : 1024;
+        out->terms = (struct sparse_term *)realloc(out->terms, *capacity * sizeof(struct sparse_term));
+    }
+    out->terms[out->count].exp = exp;
+    out->terms[out->count].coeff = coeff;
+    ++out->count;
+}
+
+// Product terms of a*b with exponent in [lo, hi), in increasing order, into out
+static void sparse_multiply_range(const struct sparse_poly *a, const struct sparse_poly *b,
+                                  long long lo, long long hi, struct sparse_poly *out) {
+    struct sparse_heap_entry *heap = (struct sparse_heap_entry *)malloc((a->count > 0 ? a->count : 1) * sizeof(struct sparse_heap_entry));
+    long *j_end = (long *)malloc((a->count > 0 ? a->count : 1) * sizeof(long));
+    long size = 0, capacity = 0;
+    out->count = 0;
+    out->terms = NULL;
+
+    // Every term of a starts at its first partner in b that lands in [lo, hi)
+    for (long i = 0; i < a->count; ++i) {
+        long long e = a->terms[i].exp;
+        long j = sparse_lower_bound(b, lo - e);
+        j_end[i] = sparse_lower_bound(b, hi - e);
+        if (j < j_end[i]) {
+            heap[size].exp = e + b->terms[j].exp;
+            heap[size].i = i;
+            heap[size].j = j;
+            ++size;
+        }
+    }
+    for (long pos = size / 2 - 1; pos >= 0; --pos) sparse_heap_down(heap, size, pos);
+
+    while (size > 0) {
+        long long exp = heap[0].exp;
+        long long coeff = 0;
+        // Pop (and advance) every pair with this exponent
+        while (size > 0 && heap[0].exp == exp) {
+            long i = heap[0].i, j = heap[0].j;
+            coeff += a->terms[i].coeff * b->terms[j].coeff;
+            if (++j < j_end[i]) {
+                heap[0].exp = a->terms[i].exp + b->terms[j].exp;
+                heap[0].j = j;
+            } else {
+                heap[0] = heap[--size];
+            }
+            sparse_heap_down(heap, size, 0);
+        }
+        if (coeff != 0) sparse_push_term(out, &capacity, exp, coeff);
+    }
+    free(heap);
+    free(j_end);
+}
+
+struct sparse_task {
+    const struct sparse_poly *a, *b;
+    long long lo, hi;            // Output exponent slice [lo, hi)
+    struct sparse_poly out;
+};
+
+void *sparse_task_run(void *arg) {
+    struct sparse_task *task = (struct sparse_task *)arg;
+    sparse_multiply_range(task->a, task->b, task->lo, task->hi, &task->out);
+    return NULL;
+}
+
+// result = a*b on num_threads threads
+static void parallel_sparse_multiply(const struct sparse_poly *a, const struct sparse_poly *b, struct sparse_poly *result) {
+    struct sparse_task *tasks = (struct sparse_task *)malloc(num_threads * sizeof(struct sparse_task));
+    pthread_t *threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    long long max_exp = (a->count > 0 && b->count > 0)
+        ? a->terms[a->count - 1].exp + b->terms[b->count - 1].exp : 0;
+    long long total = (long long)a->count * b->count;
+
+    // Slice t starts at the smallest exponent with t/num_threads of the products below it
+    long long lo = 0;
+    for (int t = 0; t < num_threads; ++t) {
+        long long hi = max_exp + 1;
+        if (t < num_threads - 1) {
+            long long target = total / num_threads * (t + 1) + total % num_threads * (t + 1) / num_threads;
+            long long left = lo, right = max_exp + 1;
+            while (left < right) {
+                long long mid = left + (right - left) / 2;
+                if (sparse_products_below(a, b, mid) >= target) right = mid;
+                else left = mid + 1;
+            }
+            hi = left;
+        }
+        tasks[t].a = a;
+        tasks[t].b = b;
+        tasks[t].lo = lo;
+        tasks[t].hi = hi;
+        lo = hi;
+    }
+
+    for (int t = 0; t < num_threads; ++t) {
+        pthread_create(&threads[t], NULL, sparse_task_run, &tasks[t]);
+    }
+    long count = 0;
+    for (int t = 0; t < num_threads; ++t) {
+        pthread_join(threads[t], NULL);
+        count += tasks[t].out.count;
+    }
+
+    result->count = 0;
+    result->terms = (struct sparse_term *)malloc((count > 0 ? count : 1) * sizeof(struct sparse_term));
+    for (int t = 0; t < num_threads; ++t) {
+        memcpy(result->terms + result->count, tasks[t].out.terms, tasks[t].out.count * sizeof(struct sparse_term));
+        result->count += tasks[t].out.count;
+        sparse_free(&tasks[t].out);
+    }
+    free(tasks);
+    free(threads);
+}
+
+// -S mode: two random sparse polynomials of degree n, serial heap vs threaded heap, and a
+// dense cross-check through the NTT path when the degree allows it
+static int run_sparse() {
+    struct sparse_poly a, b, serial_result, result;
+    sparse_random(&a, sparse_terms, n, coeff_max, STREAM_SPARSE);
+    sparse_random(&b, sparse_terms, n, coeff_max, STREAM_SPARSE + 2);
+    long long products = (long long)a.count * b.count;
+
+    printf("\n === Sparse multiplication with use of Pthreads === \n");
+    printf("Degree of the polynomials: %d\n", n);
+    printf("Terms: %ld and %ld\n", a.count, b.count);
+    printf("Number of threads: %d \n", num_threads);
+
+    double start_time = get_time();
+    sparse_multiply_range(&a, &b, 0, 2LL*n + 1, &serial_result);
+    double serial_time = get_time() - start_time;
+
+    start_time = get_time();
+    parallel_sparse_multiply(&a, &b, &result);
+    double parallel_time = get_time() - start_time;
+
+    printf("\nProduct terms: %ld\n", result.count);
+    printf("Serial multiplication time: %.10f seconds", serial_time);
+    printf("\nParallel multiplication time: %.10f seconds \n", parallel_time);
+    printf("Throughput: %.2f million term products/second\n", products / parallel_time / 1e6);
+
+    int ok = (serial_result.count == result.count)
+        && memcmp(serial_result.terms, result.terms, result.count * sizeof(struct sparse_term)) == 0;
+    if (n <= SPARSE_DENSE_CHECK) {
+        // Same product through the dense layout and the NTT
+        poly1 = (int *)malloc((n + 1) * sizeof(int));
+        poly2 = (int *)malloc((n + 1) * sizeof(int));
+        parallel_mult_result = (long long *)calloc(2*n + 1, sizeof(long long));
+        sparse_to_dense(&a, poly1, n);
+        sparse_to_dense(&b, poly2, n);
+        // The dense operands must convert back to the very same terms
+        struct sparse_poly back;
+        sparse_from_dense(poly1, n, &back);
+        if (back.count != a.count || memcmp(back.terms, a.terms, a.count * sizeof(struct sparse_term)) != 0) ok = 0;
+        sparse_free(&back);
+        sparse_from_dense(poly2, n, &back);
+        if (back.count != b.count || memcmp(back.terms, b.terms, b.count * sizeof(struct sparse_term)) != 0) ok = 0;
+        sparse_free(&back);
+        parallel_ntt();
+        long t = 0;
+        for (int k = 0; k <= 2*n && ok; ++k) {
+            long long expected = (t < result.count && result.terms[t].exp == k) ? result.terms[t++].coeff : 0;
+            if (parallel_mult_result[k] != expected) ok = 0;
+        }
+        if (t != result.count) ok = 0;
+        printf("Checked the dense round trip and against the dense NTT product.\n");
+        free(poly1);
+        free(poly2);
+        free(parallel_mult_result);
+    }
+    if (ok) {
+        printf("\nResults match (serial vs parallel).\n");
+    } else {
+        printf("Mismatch between the sparse products!\n");
+    }
+
+    sparse_free(&a);
+    sparse_free(&b);
+    sparse_free(&serial_result);
+    sparse_free(&result);
+    printf("\n");
+    return 0;
+}
+
+// -------- Algorithm dispatch --------
+// Run one of the parallel algorithms into parallel_mult_result
+static void run_algorithm(int alg) {
+    switch (alg) {
+        case ALG_KARATSUBA: parallel_karatsuba(); break;
+        case ALG_TOOM3:     parallel_toom3(); break;
+        case ALG_NTT:       parallel_ntt(); break;
+        default:            parallel_multiply(); break;
+    }
+}
+
+// Calibration callback: time alg on fresh random polynomials of the given degree
+static double time_algorithm(int alg, int degree) {
+    int *saved_poly1 = poly1, *saved_poly2 = poly2;
+    long long *saved_result = parallel_mult_result;
+    int saved_n = n;
+
+    n = degree;
+    poly1 = (int *)malloc((n+1) * sizeof(int));
+    poly2 = (int *)malloc((n+1) * sizeof(int));
+    parallel_mult_result = (long long *)calloc(2*n + 1, sizeof(long long));
+    initialize_polynomials(coeff_max);
+
+    double start_time = get_time();
+    run_algorithm(alg);
+    double elapsed = get_time() - start_time;
+
+    free(poly1);
+    free(poly2);
+    free(parallel_mult_result);
+    poly1 = saved_poly1;
+    poly2 = saved_poly2;
+    parallel_mult_result = saved_result;
+    n = saved_n;
+    return elapsed;
+}
+
+// Measure the crossovers up to degree n for this thread count and save them
+static int calibrate() {
+    static struct poly_profile profile;
+    poly_profile_load(PROFILE_PATH, &profile);
+    poly_calibrate(&profile, num_threads, poly_coeff_bits(coeff_max), n, time_algorithm);
+    if (poly_profile_save(PROFILE_PATH, &profile) != 0) {
+        fprintf(stderr, "Could not write %s\n", PROFILE_PATH);
+        return 1;
+    }
+    printf("Profile saved to %s\n", PROFILE_PATH);
+    return 0;
+}
+
+
+// Split "a.bin,b.bin" in place; returns -1 without a comma
+static int split_file_pair(char *arg, char **first, char **second) {
+    char *comma = strchr(arg, ',');
+    if (!comma || comma == arg || comma[1] == '\0') return -1;
+    *comma = '\0';
+    *first = arg;
+    *second = comma + 1;
+    return 0;
+}
+
+// -i: map both operand files in place of poly1/poly2 and take the degree from them
+static int map_input_files() {
+    char *path1, *path2;
+    uint64_t count1, count2;
+    if (split_file_pair(input_files, &path1, &path2) != 0) {
+        fprintf(stderr, "-i expects two files: a.bin,b.bin\n");
+        return -1;
+    }
+    poly1 = (int *)poly_file_map(path1, sizeof(int), &count1, &poly1_map);
+    if (!poly1) return -1;
+    poly2 = (int *)poly_file_map(path2, sizeof(int), &count2, &poly2_map);
+    if (!poly2) return -1;
+    if (count1 != count2 || count1 > (uint64_t)INT_MAX / 2) {
+        fprintf(stderr, "Operand files must have the same number of coefficients (at most %d)\n", INT_MAX / 2);
+        return -1;
+    }
+    n = (int)count1 - 1;
+    long long max1 = poly_max_abs(poly1, n + 1), max2 = poly_max_abs(poly2, n + 1);
+    operand_max = (max1 > max2) ? max1 : max2;
+    return 0;
+}
+
+// -g: write the freshly generated operands and stop
+static int write_generated_files() {
+    char *path1, *path2;
+    if (split_file_pair(generate_files, &path1, &path2) != 0) {
+        fprintf(stderr, "-g expects two files: a.bin,b.bin\n");
+        return 1;
+    }
+    if (poly_file_write(path1, poly1, sizeof(int), n + 1) != 0
+        || poly_file_write(path2, poly2, sizeof(int), n + 1) != 0) return 1;
+    printf("Wrote degree %d operands to %s and %s\n", n, path1, path2);
+    return 0;
+}
+
+
+// Print the usage message
+static void print_usage(const char *prog) {
+    printf("Usage: %s <polynomial_degree> <threads_number> [-a algorithm] [-c cutoff] [-p partition] [-s chunk] [-k kernel] [-t tile] [-b pairs] [-m prime] [-S terms]\n"
+           "       [-i a.bin,b.bin] [-o c.bin] [-g a.bin,b.bin]\n", prog);
+    printf("  -a algorithm: naive (default), karatsuba, toom3, ntt,\n");
+    printf("                auto (use the calibrated profile %s) or calibrate (write it, up to the given degree)\n", PROFILE_PATH);
+    printf("  -c cutoff: length below which Karatsuba uses the per-k kernel (default %d)\n", KARATSUBA_CUTOFF);
+    printf("  -p partition: naive split of k between threads: equal (default), balanced or dynamic\n");
+    printf("  -s chunk: coefficients claimed per grab with -p dynamic (default %d)\n", DYNAMIC_CHUNK);
+    printf("  -k kernel: per-k dot product: auto (default, from CPUID), scalar, avx2 or avx512\n");
+    printf("  -t tile: cache-blocked naive kernel: off (default), auto (from the L2 size) or a block size\n");
+    printf("  -b pairs: multiply this many independent pairs of the given degree on a persistent thread pool\n");
+    printf("  -m prime: coefficients modulo an odd prime below 2^63 (naive algorithm, lazy Montgomery reduction)\n");
+    printf("  -S terms: sparse operands with this many random terms up to the given degree (heap multiply)\n");
+    printf("  -i a.bin,b.bin: mmap the operands from polynomial files (the degree comes from the files)\n");
+    printf("  -o c.bin: stream the parallel product to a polynomial file while it is computed\n");
+    printf("  -g a.bin,b.bin: write random operands of the given degree to polynomial files and exit\n");
+    printf("Example: %s 100000 4 -a karatsuba -c 64\n", prog);
+    printf("         %s 16 4 -b 1000000\n", prog);
+    printf("         %s 1000000000 4 -S 3000\n", prog);
 }
 
 
 int main(int argc, char *argv[]) {
 
-    if (argc != 3) {
+    if (argc < 3) {
         printf("Error: Please use %s <polynomial_degree> <threads_number> \n", argv[0]);
+        print_usage(argv[0]);
+        return 1;
     }
 
-    srand(SEED);
-    // srand(time(NULL));
+    rng_seed = SEED;
+    // rng_seed = time(NULL);
 
     n = atoi(argv[1]);
     num_threads = atoi(argv[2]);
 
+    // Optional flags after the two positional arguments
+    int opt;
+    optind = 3;
+    while ((opt = getopt(argc, argv, "a:c:p:s:k:t:b:m:S:i:o:g:")) != -1) {
+        switch (opt) {
+            case 'a':
+                if (strcmp(optarg, "naive") == 0 || strcmp(optarg, "schoolbook") == 0) algorithm = ALG_NAIVE;
+                else if (strcmp(optarg, "karatsuba") == 0) algorithm = ALG_KARATSUBA;
+                else if (strcmp(optarg, "toom3") == 0) algorithm = ALG_TOOM3;
+                else if (strcmp(optarg, "ntt") == 0 || strcmp(optarg, "transform") == 0) algorithm = ALG_NTT;
+                else if (strcmp(optarg, "auto") == 0) algorithm = ALG_AUTO;
+                else if (strcmp(optarg, "calibrate") == 0) algorithm = ALG_CALIBRATE;
+                else {
+                    fprintf(stderr, "Invalid algorithm: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c':
+                karatsuba_cutoff = atoi(optarg);
+                break;
+            case 'p':
+                if (strcmp(optarg, "equal") == 0) partition = PART_EQUAL;
+                else if (strcmp(optarg, "balanced") == 0) partition = PART_BALANCED;
+                else if (strcmp(optarg, "dynamic") == 0) partition = PART_DYNAMIC;
+                else {
+                    fprintf(stderr, "Invalid partition: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 's':
+                dynamic_chunk = atoi(optarg);
+                break;
+            case 't':
+                if (strcmp(optarg, "off") == 0) tile_size = 0;
+                else if (strcmp(optarg, "auto") == 0) tile_size = -1;
+                else if ((tile_size = atoi(optarg)) <= 0) {
+                    fprintf(stderr, "Invalid tile size: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'b':
+                if ((batch_pairs = atoi(optarg)) <= 0) {
+                    fprintf(stderr, "Invalid number of pairs: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'i':
+                input_files = optarg;
+                break;
+            case 'o':
+                output_file = optarg;
+                break;
+            case 'g':
+                generate_files = optarg;
+                break;
+            case 'S':
+                if ((sparse_terms = atol(optarg)) <= 0) {
+                    fprintf(stderr, "Invalid number of terms: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'm':
+                if (poly_mod_init(&modulus, strtoull(optarg, NULL, 10)) != 0) {
+                    fprintf(stderr, "Invalid modulus: %s (must be an odd prime below 2^63)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'k':
+                if (strcmp(optarg, "auto") == 0) kernel = KERNEL_AUTO;
+                else if (strcmp(optarg, "scalar") == 0) kernel = KERNEL_SCALAR;
+                else if (strcmp(optarg, "avx2") == 0) kernel = KERNEL_AVX2;
+                else if (strcmp(optarg, "avx512") == 0) kernel = KERNEL_AVX512;
+                else {
+                    fprintf(stderr, "Invalid kernel: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (n < 0 || num_threads <= 0 || karatsuba_cutoff < 1 || dynamic_chunk < 1) {
+        fprintf(stderr, "polynomial_degree must be >= 0, threads_number, cutoff and chunk must be positive.\n");
+        return 1;
+    }
+
+    if (modulus.p && (algorithm != ALG_NAIVE || batch_pairs > 0)) {
+        fprintf(stderr, "-m is supported by the naive algorithm only.\n");
+        return 1;
+    }
+    if (sparse_terms > 0 && (modulus.p || batch_pairs > 0)) {
+        fprintf(stderr, "-S cannot be combined with -m or -b.\n");
+        return 1;
+    }
+    if ((input_files || output_file || generate_files) && (batch_pairs > 0 || sparse_terms > 0 || algorithm == ALG_CALIBRATE)) {
+        fprintf(stderr, "-i, -o and -g apply to a single dense product.\n");
+        return 1;
+    }
+    if (input_files && (modulus.p || generate_files)) {
+        fprintf(stderr, "-i cannot be combined with -m or -g.\n");
+        return 1;
+    }
+    if (input_files && map_input_files() != 0) {
+        return 1;
+    }
+
+    select_kernel();
+    select_tile_size();
+
+    if (algorithm == ALG_CALIBRATE) {
+        return calibrate();
+    }
+    if (batch_pairs > 0) {
+        return run_batch();
+    }
+    if (sparse_terms > 0) {
+        return run_sparse();
+    }
+
     printf("\n === Threads multiplication with use of Pthreads === \n");
     printf("Degree of the polynomials: %d", n);
     printf("\nNumber of threads: %d \n", num_threads);
+    printf("Dot-product kernel: %s\n", kernel_names[kernel]);
+    if (algorithm == ALG_AUTO) {
+        int from_profile;
+        algorithm = poly_dispatch(PROFILE_PATH, num_threads, poly_coeff_bits(operand_max), n, &from_profile);
+        printf("Dispatcher: %s (%s)\n", poly_alg_names[algorithm], from_profile ? PROFILE_PATH : "no profile, defaults");
+        if (poly_operand_limit(algorithm, operand_max, n + 1, karatsuba_cutoff, INT_MAX, NTT_P1 * NTT_P2)) {
+            algorithm = ALG_NAIVE; // Too large for the pick, the naive kernel only needs 64-bit sums
+            printf("Dispatcher: coefficients up to %lld, falling back to %s\n", operand_max, poly_alg_names[algorithm]);
+        }
+    }
+    const char *limit = modulus.p ? NULL : poly_operand_limit(algorithm, operand_max, n + 1, karatsuba_cutoff, INT_MAX, NTT_P1 * NTT_P2);
+    if (limit) {
+        fprintf(stderr, "Operands with coefficients up to %lld in magnitude are too large for %s: %s.\n",
+                operand_max, poly_alg_names[algorithm], limit);
+        return 1;
+    }
+    if (algorithm == ALG_KARATSUBA) {
+        printf("Algorithm: Karatsuba (cutoff %d)\n", karatsuba_cutoff);
+    } else if (algorithm == ALG_TOOM3) {
+        printf("Algorithm: Toom-3 (cutoff %d)\n", TOOM3_CUTOFF);
+    } else if (algorithm == ALG_NTT) {
+        printf("Algorithm: two-prime NTT\n");
+    } else {
+        const char *names[] = { "equal", "balanced", "dynamic" };
+        printf("Algorithm: naive per-k convolution (%s partition", names[partition]);
+        if (partition == PART_DYNAMIC) printf(", chunk %d", dynamic_chunk);
+        if (tile_size > 0 && !modulus.p) {
+            printf(", tile %d", tile_size);
+            if (l2_bytes > 0) printf(" from L2 %ld KB", l2_bytes / 1024);
+        }
+        printf(")\n");
+    }
+    if (modulus.p) {
+        printf("Coefficients: modulo %llu (Montgomery reduction every %ld products, reference reduces every product)\n",
+               (unsigned long long)modulus.p, modulus.lazy);
+    }
 
 
     // --------- Initialization ---------
     double start_time = get_time();
 
-    // Allocate memory
-    poly1 = (int *)malloc((n+1)* sizeof(int));
-    poly2 = (int *)malloc((n+1)* sizeof(int));
+    // Allocate memory (the operands are already mapped with -i)
+    if (!input_files) {
+        poly1 = (int *)malloc((n+1)* sizeof(int));
+        poly2 = (int *)malloc((n+1)* sizeof(int));
+    }
 
-    serial_mult_result = (int *)malloc((2*n+1)* sizeof(int));
-    parallel_mult_result = (int *)malloc((2*n+1)* sizeof(int));
-    memset(serial_mult_result, 0, (2*n+1)*sizeof(int));
-    memset(parallel_mult_result, 0, (2*n+1)*sizeof(int));
+    serial_mult_result = (long long *)malloc((2*n+1)* sizeof(long long));
+    parallel_mult_result = (long long *)malloc((2*n+1)* sizeof(long long));
+    memset(serial_mult_result, 0, (2*n+1)*sizeof(long long));
+    memset(parallel_mult_result, 0, (2*n+1)*sizeof(long long));
 
-    int coeff_max = 10;
-    initialize_polynomials(coeff_max);
+    if (!input_files) initialize_polynomials(coeff_max);
+    if (modulus.p) initialize_mod_polynomials();
 
     double init_time = get_time() - start_time;
+    if (generate_files) {
+        int status = write_generated_files();
+        free(poly1);
+        free(poly2);
+        free(serial_mult_result);
+        free(parallel_mult_result);
+        return status;
+    }
     
 
     // --------- Serial Polynomial Multiplication ---------
     start_time = get_time();
     // serial_polynomial_multiplication();
-    serial_polynomial_multiplication_k();
+    if (modulus.p) {
+        serial_mod_multiplication();
+    } else {
+        serial_polynomial_multiplication_k();
+    }
     double serial_time = get_time() - start_time;
     
 
     // --------- Parallel Polynomial Multiplication ---------
+    // With -o the naive path streams finished blocks while it computes; the other
+    // algorithms only have the product at the end and hand it over in one piece
+    struct poly_writer writer;
+    if (output_file) {
+        if (poly_writer_open(&writer, output_file, 2*n + 1) != 0) return 1;
+        stream_writer = &writer;
+    }
     start_time = get_time();
-    parallel_multiply();
+    run_algorithm(algorithm);
     double parallel_time = get_time() - start_time;
+    double flush_time = 0;
+    int write_status = 0;
+    if (output_file) {
+        if (algorithm != ALG_NAIVE) poly_writer_submit(&writer, parallel_mult_result, 0, 2*n + 1);
+        start_time = get_time();
+        write_status = poly_writer_close(&writer);
+        flush_time = get_time() - start_time;
+        stream_writer = NULL;
+    }
     
 
     // --------- Timing Results ---------
     printf("\nInitialization time: %.10f seconds", init_time);
     printf("\nSerial multiplication time: %.10f seconds", serial_time);
     printf("\nParallel multiplication time: %.10f seconds \n", parallel_time);
+    if (algorithm == ALG_NAIVE) {
+        // (n+1)^2 multiply-adds in the schoolbook product
+        printf("Throughput: %.2f million multiply-adds/second\n", (double)(n + 1) * (n + 1) / parallel_time / 1e6);
+        print_thread_busy();
+    }
+    if (output_file) {
+        printf("Output: %s, %.10f seconds of writing left after the product was done%s\n",
+               output_file, flush_time, write_status == 0 ? "" : " (WRITE FAILED)");
+    }
 
 
     // --------- Verification ---------
@@ -178,6 +1910,19 @@ int main(int argc, char *argv[]) {
     } else {
         printf("Mismatch in %d coefficients!\n", mism);
     }
+    if (output_file && write_status == 0) {
+        // Read the streamed file back through the same mapping path as the inputs
+        struct poly_mapping out_map;
+        uint64_t count;
+        const long long *written = (const long long *)poly_file_map(output_file, sizeof(long long), &count, &out_map);
+        if (written && count == (uint64_t)(2*n + 1)
+            && memcmp(written, parallel_mult_result, count * sizeof(long long)) == 0) {
+            printf("Output file matches the parallel product.\n");
+        } else {
+            printf("Output file does not match the parallel product!\n");
+        }
+        poly_file_unmap(&out_map);
+    }
 
     // Print the polynomials
     // printf("\n");
@@ -193,17 +1938,25 @@ int main(int argc, char *argv[]) {
 
     // printf("\n Serial Multiplication Polynomial: ");
     // for(int i = 0; i <= 2*n; i++){
-    //     printf("%dx^%d", serial_mult_result[i], i);
+    //     printf("%lldx^%d", serial_mult_result[i], i);
     // }
 
 
 
 
     // Free the allocated memory
-    free(poly1);
-    free(poly2);
+    if (input_files) {
+        poly_file_unmap(&poly1_map);
+        poly_file_unmap(&poly2_map);
+    } else {
+        free(poly1);
+        free(poly2);
+    }
     free(serial_mult_result);
     free(parallel_mult_result);
+    free(thread_busy);
+    free(mod_poly1);
+    free(mod_poly2);
 
 
     printf("\n");
@@ -1,211 +1,984 @@
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
 #include <sys/time.h>
 #include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#include "counter_rng.h"
 
 #define SEED 4
 #define DEBUG 0
+#define CACHE_LINE 64
 
 #ifndef USE_PADDING
 #define USE_PADDING 0
 #endif
 
-// --- Original Structure to hold the non zero counts for each array ---   
-// When USE_PADDING is set to 0, this structure will be used
-struct array_stats_s0 {
-    long long int info_array_0;
-    long long int info_array_1;
-    long long int info_array_2;
-    long long int info_array_3;
-} array_stats_0;
-
-// --- Better Structure with padding to avoid false sharing ---
-// When USE_PADDING is set to 1, this structure will be used
-struct array_stats_s1 {
-    long long int info_array_0;
-    char padding0[56];  // 64 - 8 = 56 bytes padding
-    long long int info_array_1;
-    char padding1[56];
-    long long int info_array_2;
-    char padding2[56];
-    long long int info_array_3;
-    char padding3[56];
-} array_stats_1;
-
-
-#if USE_PADDING
-#define array_stats array_stats_1
-#else
-#define array_stats array_stats_0
+// C has no std::hardware_destructive_interference_size; override with -D for other CPUs
+#ifndef DESTRUCTIVE_INTERFERENCE_SIZE
+#define DESTRUCTIVE_INTERFERENCE_SIZE 64
 #endif
 
+// Only print the report when not in CSV mode (-C)
+#define REPORT(...) do { if (!csv_mode) printf(__VA_ARGS__); } while (0)
+
+// Counting kernels of the vectorized parallel step, picked at runtime from CPUID
+#define KERNEL_SCALAR 0
+#define KERNEL_AVX2   1
+#define KERNEL_AVX512 2
+#define KERNEL_AUTO   3
+
+// Storage scanned by the partitioned step
+#define LAYOUT_INT    0   // int per element (the original arrays)
+#define LAYOUT_BYTES  1   // uint8_t per element (-c)
+#define LAYOUT_BITMAP 2   // one bit per element, set for nonzero values (-b)
+
+// Layouts of the shared counts of the one-thread-per-array step (-L), the false-sharing
+// experiment. Every layout is num_arrays counts stats_stride bytes apart.
+#define STATS_PADDED    0   // count + pad bytes (-P): pad 0 packs the counts into shared
+                            // lines (original structure), pad 56 gives each its own line
+#define STATS_ALIGNED   1   // struct array_stats_aligned
+#define STATS_STRIDE128 2   // one count per 128 bytes: the adjacent-line prefetcher pulls
+                            // lines in 128-byte pairs, so 64 bytes can still interfere
+#define STATS_STACK     3   // packed counts, but each thread counts in a local variable on
+                            // its stack and stores once at the end
+
+struct array_stats_aligned {
+    _Alignas(DESTRUCTIVE_INTERFERENCE_SIZE) long long int info_array;
+};
+
+static const char *stats_layout_names[] = { "padded", "aligned", "stride128", "stack" };
+int stats_layout = STATS_PADDED;
+int stats_pad = USE_PADDING ? 56 : 0;   // 1c_padded keeps its old default
+int stats_stride;
+char *array_stats;                      // One count per array, stats_stride bytes apart
+#define ARRAY_STAT(a) (*(long long int*)(array_stats + (long long)(a) * stats_stride))
+
+int csv_mode = 0;   // -C: print one CSV row instead of the report
+
+// --- Fused statistics (-F) ---
+// One pass over the arrays computes every statistic in the mask. Threads take the same
+// equal spans as the partitioned step and summarize each piece of array they cover in
+// their own padded segment (private histogram bins included); the segments of an array
+// are then merged in span order. Runs are maximal stretches of equal consecutive values,
+// so a segment keeps the runs touching its ends to join them with its neighbours.
+#define STAT_HIST   1   // Histogram of the values 0-9
+#define STAT_SUM    2
+#define STAT_MINMAX 4
+#define STAT_RUNS   8   // Number of runs and longest run
+#define STAT_COUNT  4
+#define STAT_ALL    (STAT_HIST | STAT_SUM | STAT_MINMAX | STAT_RUNS)
+
+static const char *stat_names[] = { "histogram", "sum", "min/max", "runs" };
+
+struct segment_stats {
+    _Alignas(CACHE_LINE) long long hist[10];
+    long long sum;
+    int min, max;
+    long long runs, longest;
+    long long len;                  // Elements summarized
+    int first, last;                // First and last value
+    long long head, tail;           // Length of the first and of the last run
+};
+
+struct segment_stats *segments;     // num_threads rows of num_arrays segments
+unsigned fused_mask;
+#define CSV_COLUMNS "array_size,arrays,threads,layout,pad_bytes,stride_bytes,creation_s,serial_s,parallel_s,vectorized_s,correct"
+
+
+// The arrays
+int **arrays;
+int *array_sizes;     // Size of each array
+int num_arrays = 4;
+int num_threads = 4;  // Threads of the partitioned step
+int array_size;       // Size of the largest array
+long long total_elements;
 
-// The 4 arrays
-int *array_0;
-int *array_1;
-int *array_2;
-int *array_3;
-int array_size;  // Size of each array
+// --- Partitioned step ---
+// Thread t owns elements [total * t / T, total * (t + 1) / T) of the arrays laid end to
+// end, so every thread gets the same amount of work whatever the array sizes are: a span
+// may cover the tail of one array and the head of the next. Partial counts go to the
+// thread's own row of partials (rows are padded to whole cache lines), and the last
+// thread to finish sums the rows; finishing is counted with an atomic, so there is no lock.
+long long *partials;          // num_threads rows of partial_stride counts
+int partial_stride;           // num_arrays rounded up to a whole number of cache lines
+long long *array_offsets;     // Start of each array in the concatenated index space
+atomic_int threads_done;
+long long *partitioned_counts;  // Result of the partitioned step, one per array
+int pass_layout;              // What the running partitioned step scans
+long long *pass_offsets;      // Start of each array in its index space (elements or words)
+long long pass_total;
+
+// --- Compact layout (-c, -b) ---
+// The values are 0-9, so a byte holds each one; the bitmap keeps only "is nonzero", 64
+// elements per word, and counting becomes a popcount over 1/32 of the int data.
+uint8_t **byte_arrays;
+uint64_t **bitmaps;           // Bits past the end of an array are 0
+long long *word_offsets;      // Start of each bitmap in the concatenated word space
+long long total_words;
+
+// --- Incrementally maintained counts (-W) ---
+// Writers change elements while the counts stay exact: a write swaps the element
+// atomically and turns the zero/nonzero transition it made into a -1/0/+1 delta. Each
+// writer adds its deltas to its own shard (a cache-line-padded row, written by that thread
+// only), so updates are O(1) and never contended. A query sums one column over the shards;
+// while writes are in flight it may miss the ones not yet applied, at quiescence it is exact.
+struct live_stats {
+    long long *shards;        // shard_count rows of partial_stride counts
+    int shard_count;
+};
+
+struct live_stats live;
+long long updates_per_writer = 0;   // -W: writes done by each writer thread
+atomic_int writers_running;
 
 
 // --- Function declarations ---
 void* count_nonzero(void *arg);
-void serial_count(long long *result_0, long long *result_1, long long *result_2, long long *result_3);
+void* count_nonzero_partitioned(void *arg);
+void* live_writer(void *arg);
+void* live_reader(void *arg);
+void* fused_worker(void *arg);
+void serial_count(long long *results);
 double get_time_diff(struct timeval start, struct timeval end);
+double get_bandwidth(double seconds, double bytes);
+
+
+
+
+// --- Counting kernels ---
+// Number of nonzero ints in x[0 .. count). The count stays in a register and each kernel
+// returns it once, with no branch per element: the scalar version adds the comparison
+// result, the SIMD versions compare a whole vector against zero, turn it into a bit mask
+// (movemask / AVX-512 mask register) and add its popcount.
+static long long count_scalar(const int *x, int count) {
+    long long nonzero = 0;
+    for (int i = 0; i < count; i++) {
+        nonzero += (x[i] != 0);
+    }
+    return nonzero;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("avx2,popcnt")))
+static long long count_avx2(const int *x, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    long long zeros = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, zero)));
+        zeros += _mm_popcnt_u32(mask);
+    }
+    long long nonzero = i - zeros;
+    for (; i < count; i++) {
+        nonzero += (x[i] != 0);
+    }
+    return nonzero;
+}
+
+__attribute__((target("avx512f,popcnt")))
+static long long count_avx512(const int *x, int count) {
+    const __m512i zero = _mm512_setzero_si512();
+    long long nonzero = 0;
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i v = _mm512_loadu_si512((const void *)(x + i));
+        nonzero += _mm_popcnt_u32(_mm512_cmpneq_epi32_mask(v, zero));
+    }
+    for (; i < count; i++) {
+        nonzero += (x[i] != 0);
+    }
+    return nonzero;
+}
+#endif
+
+// Same count over uint8_t values, and the popcount of bitmap words
+static long long count_bytes_scalar(const uint8_t *x, long long count) {
+    long long nonzero = 0;
+    for (long long i = 0; i < count; i++) {
+        nonzero += (x[i] != 0);
+    }
+    return nonzero;
+}
+
+static long long popcount_scalar(const uint64_t *words, long long count) {
+    long long bits = 0;
+    for (long long i = 0; i < count; i++) {
+        bits += __builtin_popcountll(words[i]);
+    }
+    return bits;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("avx2,popcnt")))
+static long long count_bytes_avx2(const uint8_t *x, long long count) {
+    const __m256i zero = _mm256_setzero_si256();
+    long long zeros = 0;
+    long long i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+        zeros += _mm_popcnt_u32((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)));
+    }
+    long long nonzero = i - zeros;
+    for (; i < count; i++) {
+        nonzero += (x[i] != 0);
+    }
+    return nonzero;
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static long long count_bytes_avx512(const uint8_t *x, long long count) {
+    const __m512i zero = _mm512_setzero_si512();
+    long long nonzero = 0;
+    long long i = 0;
+    for (; i + 64 <= count; i += 64) {
+        __m512i v = _mm512_loadu_si512((const void *)(x + i));
+        nonzero += _mm_popcnt_u64(_mm512_cmpneq_epi8_mask(v, zero));
+    }
+    for (; i < count; i++) {
+        nonzero += (x[i] != 0);
+    }
+    return nonzero;
+}
+
+__attribute__((target("popcnt")))
+static long long popcount_hw(const uint64_t *words, long long count) {
+    long long bits = 0;
+    for (long long i = 0; i < count; i++) {
+        bits += _mm_popcnt_u64(words[i]);
+    }
+    return bits;
+}
+#endif
+
+static long long (*count_kernel)(const int *, int) = count_scalar;
+static long long (*count_bytes_kernel)(const uint8_t *, long long) = count_bytes_scalar;
+static long long (*popcount_kernel)(const uint64_t *, long long) = popcount_scalar;
+static const char *kernel_names[] = { "scalar", "avx2", "avx512" };
+int kernel = KERNEL_AUTO;
+
+// Resolve KERNEL_AUTO (or a forced kernel the CPU lacks) from CPUID and install it
+static void select_kernel() {
+    int best = KERNEL_SCALAR;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) best = KERNEL_AVX2;
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt")) best = KERNEL_AVX512;
+#endif
+    if (kernel == KERNEL_AUTO || kernel > best) kernel = best;
+
+    switch (kernel) {
+#ifdef HAVE_X86_SIMD
+        case KERNEL_AVX512: count_kernel = count_avx512; break;
+        case KERNEL_AVX2:   count_kernel = count_avx2; break;
+#endif
+        default:            count_kernel = count_scalar; break;
+    }
+
+    // The byte and bitmap kernels follow the same choice (AVX-512 bytes also need BW)
+#ifdef HAVE_X86_SIMD
+    if (kernel >= KERNEL_AVX2) {
+        count_bytes_kernel = (kernel == KERNEL_AVX512 && __builtin_cpu_supports("avx512bw")) ? count_bytes_avx512 : count_bytes_avx2;
+        popcount_kernel = popcount_hw;
+    }
+#endif
+}
+
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s <array_size> [-n arrays] [-t threads] [-k scalar|avx2|avx512|auto] [-u] [-c] [-b] [-W updates]\n"
+           "       [-L layout] [-P bytes] [-C] [-F]\n", prog);
+    printf("  -n: number of arrays (default 4)\n");
+    printf("  -t: threads of the partitioned step (default 4)\n");
+    printf("  -k: counting kernel of the partitioned step (default auto)\n");
+    printf("  -u: unequal sizes, array i gets array_size * (i + 1) / arrays elements\n");
+    printf("  -c: also store the values as uint8_t and count those\n");
+    printf("  -b: like -c, plus a nonzero bitmap counted with popcount\n");
+    printf("  -W updates: each of the threads writes this many random elements while a reader\n");
+    printf("      queries the incrementally maintained counts\n");
+    printf("  -L padded|aligned|stride128|stack: layout of the shared counts (one thread per array)\n");
+    printf("  -P bytes: pad after each count in the padded layout (default %d)\n", USE_PADDING ? 56 : 0);
+    printf("  -C: print one CSV row (%s)\n", CSV_COLUMNS);
+    printf("  -F: fused single-pass histogram, sum, min/max and runs, against separate passes\n");
+    printf("Example: %s 10000 \n", prog);
+}
+
+// Do two counts arrays match?
+static int same_counts(const long long *x, const long long *y) {
+    for (int a = 0; a < num_arrays; a++) {
+        if (x[a] != y[a]) return 0;
+    }
+    return 1;
+}
+
+static void print_counts(const char *label, const long long *counts) {
+    printf("> %s results:", label);
+    for (int a = 0; a < num_arrays; a++) printf(" %lld", counts[a]);
+    printf("\n\n");
+}
+
+// Run the partitioned step over the given layout on num_threads threads and return its time
+static double run_partitioned(pthread_t *threads, int *ids, int layout, long long *offsets, long long total) {
+    struct timeval start, end;
+    pass_layout = layout;
+    pass_offsets = offsets;
+    pass_total = total;
+    memset(partitioned_counts, 0, num_arrays * sizeof(long long));
+    atomic_store(&threads_done, 0);
+
+    gettimeofday(&start, NULL);
+
+    for (int t = 0; t < num_threads; t++) {
+        ids[t] = t;
+        pthread_create(&threads[t], NULL, count_nonzero_partitioned, &ids[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    gettimeofday(&end, NULL);
+    return get_time_diff(start, end);
+}
+
+// Compact copy of the arrays: regenerate each value from the same RNG stream as the int
+// array, as a byte and (with bitmaps) as a bit. Filled by whole bitmap words so no two
+// threads write the same word.
+struct compact_fill {
+    int array;
+    uint64_t key;
+};
+
+static void compact_fill_range(void *ctx, long start, long end) {
+    struct compact_fill *f = (struct compact_fill *)ctx;
+    uint8_t *bytes = byte_arrays[f->array];
+    uint64_t *bits = bitmaps ? bitmaps[f->array] : NULL;
+    long size = array_sizes[f->array];
+    for (long w = start; w < end; w++) {
+        uint64_t word = 0;
+        for (long i = w * 64; i < size && i < (w + 1) * 64; i++) {
+            int value = crng_int_in(f->key, i, 0, 9);
+            bytes[i] = (uint8_t)value;
+            word |= (uint64_t)(value != 0) << (i - w * 64);
+        }
+        if (bits) bits[w] = word;
+    }
+}
+
+// Start from known counts: shard 0 holds them, the other shards hold deltas
+static void live_stats_init(struct live_stats *stats, int shard_count, const long long *counts) {
+    stats->shard_count = shard_count;
+    stats->shards = (long long*)aligned_alloc(CACHE_LINE, shard_count * partial_stride * sizeof(long long));
+    memset(stats->shards, 0, shard_count * partial_stride * sizeof(long long));
+    for (int a = 0; a < num_arrays; a++) stats->shards[a] = counts[a];
+}
+
+// arrays[a][i] = value on behalf of the writer owning shard; O(1)
+static void live_stats_write(struct live_stats *stats, int shard, int a, int i, int value) {
+    int old = __atomic_exchange_n(&arrays[a][i], value, __ATOMIC_RELAXED);
+    int delta = (value != 0) - (old != 0);
+    if (delta != 0) {
+        long long *slot = &stats->shards[(long long)shard * partial_stride + a];
+        // Only this writer updates the slot; the atomic store keeps concurrent reads untorn
+        __atomic_store_n(slot, *slot + delta, __ATOMIC_RELAXED);
+    }
+}
+
+// Current nonzero count of array a, merged over the shards
+static long long live_stats_query(const struct live_stats *stats, int a) {
+    long long sum = 0;
+    for (int shard = 0; shard < stats->shard_count; shard++) {
+        sum += __atomic_load_n(&stats->shards[(long long)shard * partial_stride + a], __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+static double get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Query statistics gathered by live_reader()
+struct reader_result {
+    long long queries;
+    double total_ns, max_ns;
+};
+
+// Statistics in mask over x[0 .. count), accumulated in locals and stored once
+static void fused_pass(const int *x, long long count, unsigned mask, struct segment_stats *out) {
+    long long hist[10] = { 0 };
+    long long sum = 0, runs = 0, longest = 0, run = 0, head = 0;
+    int min = 9, max = 0, prev = -1;
+
+    for (long long i = 0; i < count; i++) {
+        int v = x[i];
+        if (mask & STAT_HIST) hist[v]++;
+        if (mask & STAT_SUM) sum += v;
+        if (mask & STAT_MINMAX) {
+            if (v < min) min = v;
+            if (v > max) max = v;
+        }
+        if (mask & STAT_RUNS) {
+            if (v == prev) {
+                run++;
+            } else {
+                if (runs == 1) head = run;
+                if (run > longest) longest = run;
+                runs++;
+                run = 1;
+                prev = v;
+            }
+        }
+    }
+
+    memcpy(out->hist, hist, sizeof(hist));
+    out->sum = sum;
+    out->min = min;
+    out->max = max;
+    out->len = count;
+    if (mask & STAT_RUNS) {
+        if (run > longest) longest = run;
+        out->runs = runs;
+        out->longest = longest;
+        out->first = (count > 0) ? x[0] : -1;
+        out->last = prev;
+        out->head = (runs == 1) ? run : head;
+        out->tail = run;
+    } else { // Not gathered: defined values, merge_segments() skips them
+        out->runs = out->longest = out->head = out->tail = 0;
+        out->first = out->last = -1;
+    }
+}
+
+// Append segment b (the elements right after a) to a
+static void merge_segments(struct segment_stats *a, const struct segment_stats *b) {
+    if (b->len == 0) return;
+    if (a->len == 0) {
+        *a = *b;
+        return;
+    }
+    for (int v = 0; v < 10; v++) a->hist[v] += b->hist[v];
+    a->sum += b->sum;
+    if (b->min < a->min) a->min = b->min;
+    if (b->max > a->max) a->max = b->max;
+
+    if (fused_mask & STAT_RUNS) {
+        int joined = (a->last == b->first);
+        long long middle = joined ? a->tail + b->head : 0;
+        a->runs += b->runs - joined;
+        if (b->longest > a->longest) a->longest = b->longest;
+        if (middle > a->longest) a->longest = middle;
+        if (joined && a->head == a->len) a->head += b->head;
+        a->tail = (joined && b->tail == b->len) ? a->tail + b->tail : b->tail;
+        a->last = b->last;
+    }
+    a->len += b->len;
+}
+
+// One fused pass with the given mask on num_threads threads, merged into result (one per array)
+static double run_fused(pthread_t *threads, int *ids, unsigned mask, struct segment_stats *result) {
+    struct timeval start, end;
+    fused_mask = mask;
+
+    gettimeofday(&start, NULL);
+
+    for (int t = 0; t < num_threads; t++) {
+        ids[t] = t;
+        pthread_create(&threads[t], NULL, fused_worker, &ids[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    for (int a = 0; a < num_arrays; a++) {
+        result[a].len = 0;
+        for (int t = 0; t < num_threads; t++) {
+            merge_segments(&result[a], &segments[(long long)t * num_arrays + a]);
+        }
+    }
+
+    gettimeofday(&end, NULL);
+    return get_time_diff(start, end);
+}
 
 
 // Main function
 int main(int argc, char *argv[]) {
 
-    if (argc != 2) {
-        printf("Usage: %s <array_size>\n", argv[0]);
-        printf("Example: %s 10000 \n", argv[0]);
+    if (argc < 2) {
+        print_usage(argv[0]);
         return 1;
     }
 
     // Parse arguments
     array_size = atoi(argv[1]);
+    int unequal = 0;
+    int compact = 0;    // LAYOUT_BYTES: -c, LAYOUT_BITMAP: -b
+    int opt;
+    optind = 2;
+    int fused = 0;
+    while ((opt = getopt(argc, argv, "n:t:k:ucbW:L:P:CF")) != -1) {
+        switch (opt) {
+            case 'n': num_arrays = atoi(optarg); break;
+            case 't': num_threads = atoi(optarg); break;
+            case 'k':
+                if (strcmp(optarg, "scalar") == 0) kernel = KERNEL_SCALAR;
+                else if (strcmp(optarg, "avx2") == 0) kernel = KERNEL_AVX2;
+                else if (strcmp(optarg, "avx512") == 0) kernel = KERNEL_AVX512;
+                else if (strcmp(optarg, "auto") == 0) kernel = KERNEL_AUTO;
+                else {
+                    printf("Unknown kernel %s (scalar, avx2, avx512 or auto)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'u': unequal = 1; break;
+            case 'c': if (compact < LAYOUT_BYTES) compact = LAYOUT_BYTES; break;
+            case 'b': compact = LAYOUT_BITMAP; break;
+            case 'W': updates_per_writer = atoll(optarg); break;
+            case 'L':
+                stats_layout = -1;
+                for (int l = 0; l < 4; l++) {
+                    if (strcmp(optarg, stats_layout_names[l]) == 0) stats_layout = l;
+                }
+                if (stats_layout < 0) {
+                    printf("Unknown layout %s (padded, aligned, stride128 or stack)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'P': stats_pad = atoi(optarg); break;
+            case 'C': csv_mode = 1; break;
+            case 'F': fused = 1; break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (array_size < 0 || num_arrays < 1 || num_threads < 1 || updates_per_writer < 0 || stats_pad < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    select_kernel();
+
+    int stats_align = CACHE_LINE;
+    switch (stats_layout) {
+        case STATS_ALIGNED:
+            stats_stride = sizeof(struct array_stats_aligned);
+            stats_align = _Alignof(struct array_stats_aligned);
+            break;
+        case STATS_STRIDE128:
+            stats_stride = 128;
+            stats_align = 128;
+            break;
+        case STATS_STACK:
+            stats_stride = sizeof(long long int);
+            break;
+        default:
+            stats_stride = sizeof(long long int) + stats_pad;
+            break;
+    }
 
     // Print configuration
-    printf("---- Non Zero Counter for 4 arrays ----\n");
-    printf("Array size: %d elements\n", array_size);
+    REPORT("---- Non Zero Counter for %d arrays ----\n", num_arrays);
+    REPORT("Array size: %d elements%s\n", array_size, unequal ? " (largest, unequal sizes)" : "");
+    REPORT("Threads (partitioned step): %d\n", num_threads);
+    REPORT("Counting kernel (partitioned step): %s\n", kernel_names[kernel]);
+    REPORT("Shared counts layout: %s (%d-byte stride)\n", stats_layout_names[stats_layout], stats_stride);
 
-    srand(time(NULL));
-    // srand(SEED); // For reproducibility
+    uint64_t rng_seed = time(NULL);
+    // uint64_t rng_seed = SEED; // For reproducibility
 
 
-    // STEP 1: Memory allocation and initialization of the 4 arrays and start timing
+    // STEP 1: Memory allocation and initialization of the arrays and start timing
     struct timeval start, end;
-    int i;
     gettimeofday(&start, NULL);
-    
-    array_0 = (int*)malloc(array_size * sizeof(int));
-    array_1 = (int*)malloc(array_size * sizeof(int));
-    array_2 = (int*)malloc(array_size * sizeof(int));
-    array_3 = (int*)malloc(array_size * sizeof(int));
-    
-    // Initialize with random numbers 0-9
-    for (i = 0; i < array_size; i++) {
-        array_0[i] = rand() % 10;
-        array_1[i] = rand() % 10;
-        array_2[i] = rand() % 10;
-        array_3[i] = rand() % 10;
-    }
-    
+
+    arrays = (int**)malloc(num_arrays * sizeof(int*));
+    array_sizes = (int*)malloc(num_arrays * sizeof(int));
+    array_offsets = (long long*)malloc((num_arrays + 1) * sizeof(long long));
+    total_elements = 0;
+    for (int a = 0; a < num_arrays; a++) {
+        array_sizes[a] = unequal ? (int)((long long)array_size * (a + 1) / num_arrays) : array_size;
+        array_offsets[a] = total_elements;
+        total_elements += array_sizes[a];
+        arrays[a] = (int*)malloc(array_sizes[a] * sizeof(int));
+
+        // Initialize with random numbers 0-9, one counter RNG stream per array
+        crng_fill_ints(arrays[a], array_sizes[a], rng_seed, a, 0, 9, num_threads);
+    }
+    array_offsets[num_arrays] = total_elements;
+
     gettimeofday(&end, NULL);
 
-    printf("--- Results ---\n");
-    printf("> Array creation time: %.6f seconds\n", get_time_diff(start, end));
-    
+    double creation_time = get_time_diff(start, end);
+    REPORT("--- Results ---\n");
+    REPORT("> Array creation time: %.6f seconds\n", creation_time);
+
     // STEP 2: Serial execution
-    long long serial_0, serial_1, serial_2, serial_3;
-    
+    long long *serial_counts = (long long*)malloc(num_arrays * sizeof(long long));
+
     gettimeofday(&start, NULL);
-    serial_count(&serial_0, &serial_1, &serial_2, &serial_3);
+    serial_count(serial_counts);
     gettimeofday(&end, NULL);
-    
-    printf("> Serial execution time: %.6f seconds\n", get_time_diff(start, end));
-    if (DEBUG) {printf("> Serial results: %lld, %lld, %lld, %lld\n\n", serial_0, serial_1, serial_2, serial_3); }
 
+    double serial_time = get_time_diff(start, end);
+    REPORT("> Serial execution time: %.6f seconds\n", serial_time);
+    REPORT("> Serial bandwidth: %.3f GB/s\n", get_bandwidth(serial_time, total_elements * sizeof(int)));
+    if (DEBUG) print_counts("Serial", serial_counts);
 
-    // STEP 3: Parallel execution with threads    
+
+    // STEP 3: Parallel execution with one thread per array
     // Reset the shared structure
-    array_stats.info_array_0 = 0;
-    array_stats.info_array_1 = 0;
-    array_stats.info_array_2 = 0;
-    array_stats.info_array_3 = 0;
-
-    // Create the 4 threads
-    pthread_t thread_0, thread_1, thread_2, thread_3;
-    int id_0 = 0, id_1 = 1, id_2 = 2, id_3 = 3;
-    
+    size_t stats_bytes = (((size_t)num_arrays * stats_stride + stats_align - 1) / stats_align) * stats_align;
+    array_stats = (char*)aligned_alloc(stats_align, stats_bytes);
+    memset(array_stats, 0, stats_bytes);
+
+    pthread_t *threads = (pthread_t*)malloc((num_arrays > num_threads ? num_arrays : num_threads) * sizeof(pthread_t));
+    int *ids = (int*)malloc((num_arrays > num_threads ? num_arrays : num_threads) * sizeof(int));
+
     gettimeofday(&start, NULL);
-    
-    pthread_create(&thread_0, NULL, count_nonzero, &id_0);
-    pthread_create(&thread_1, NULL, count_nonzero, &id_1);
-    pthread_create(&thread_2, NULL, count_nonzero, &id_2);
-    pthread_create(&thread_3, NULL, count_nonzero, &id_3);
-    
-    // Wait for all 4 threads to finish
-    pthread_join(thread_0, NULL);
-    pthread_join(thread_1, NULL);
-    pthread_join(thread_2, NULL);
-    pthread_join(thread_3, NULL);
-    
+
+    for (int a = 0; a < num_arrays; a++) {
+        ids[a] = a;
+        pthread_create(&threads[a], NULL, count_nonzero, &ids[a]);
+    }
+
+    // Wait for all threads to finish
+    for (int a = 0; a < num_arrays; a++) {
+        pthread_join(threads[a], NULL);
+    }
+
     gettimeofday(&end, NULL);
-    
-    printf("> Parallel execution time: %.6f seconds\n", get_time_diff(start, end));
-    if (DEBUG) {printf("> Parallel results: %lld, %lld, %lld, %lld\n\n", array_stats.info_array_0, array_stats.info_array_1, array_stats.info_array_2, array_stats.info_array_3); }
-    
+
+    double parallel_time = get_time_diff(start, end);
+    long long *parallel_counts = (long long*)malloc(num_arrays * sizeof(long long));
+    for (int a = 0; a < num_arrays; a++) parallel_counts[a] = ARRAY_STAT(a);
+    REPORT("> Parallel execution time: %.6f seconds\n", parallel_time);
+    REPORT("> Parallel bandwidth: %.3f GB/s\n", get_bandwidth(parallel_time, total_elements * sizeof(int)));
+    if (DEBUG) print_counts("Parallel", parallel_counts);
+
     // STEP 4: Correctness check
-    if (serial_0 == array_stats.info_array_0 && serial_1 == array_stats.info_array_1 &&
-        serial_2 == array_stats.info_array_2 && serial_3 == array_stats.info_array_3) {
-        printf("> Status: SUCCESS - Serial and parallel results are correct!\n");
+    int parallel_ok = same_counts(serial_counts, parallel_counts);
+
+    // STEP 5: Partitioned parallel execution on num_threads threads, counting with the
+    // vectorized kernel in registers and reducing through padded per-thread partials
+    partial_stride = ((num_arrays * sizeof(long long) + CACHE_LINE - 1) / CACHE_LINE) * CACHE_LINE / sizeof(long long);
+    partials = (long long*)aligned_alloc(CACHE_LINE, num_threads * partial_stride * sizeof(long long));
+    partitioned_counts = (long long*)calloc(num_arrays, sizeof(long long));
+
+    double simd_time = run_partitioned(threads, ids, LAYOUT_INT, array_offsets, total_elements);
+    REPORT("> Vectorized parallel execution time: %.6f seconds\n", simd_time);
+    REPORT("> Vectorized parallel bandwidth: %.3f GB/s\n", get_bandwidth(simd_time, total_elements * sizeof(int)));
+    if (DEBUG) print_counts("Vectorized", partitioned_counts);
+
+    int simd_ok = same_counts(serial_counts, partitioned_counts);
+
+    // STEP 6 (-c / -b): compact layout, built in parallel and counted with the partitioned step
+    int compact_ok = 1;
+    if (compact) {
+        gettimeofday(&start, NULL);
+
+        byte_arrays = (uint8_t**)malloc(num_arrays * sizeof(uint8_t*));
+        bitmaps = (compact == LAYOUT_BITMAP) ? (uint64_t**)malloc(num_arrays * sizeof(uint64_t*)) : NULL;
+        word_offsets = (long long*)malloc((num_arrays + 1) * sizeof(long long));
+        total_words = 0;
+        for (int a = 0; a < num_arrays; a++) {
+            long words = (array_sizes[a] + 63) / 64;
+            word_offsets[a] = total_words;
+            total_words += words;
+            byte_arrays[a] = (uint8_t*)malloc(array_sizes[a]);
+            if (bitmaps) bitmaps[a] = (uint64_t*)malloc(words * sizeof(uint64_t));
+
+            struct compact_fill f = { a, crng_key(rng_seed, a) };
+            crng_parallel_fill(words, num_threads, compact_fill_range, &f);
+        }
+        word_offsets[num_arrays] = total_words;
+
+        gettimeofday(&end, NULL);
+
+        REPORT("> Compact creation time (uint8_t%s): %.6f seconds\n", bitmaps ? " + bitmap" : "", get_time_diff(start, end));
+        REPORT("> Memory footprint: int %.3f MB, uint8_t %.3f MB", total_elements * sizeof(int) / 1e6, total_elements / 1e6);
+        if (bitmaps) REPORT(", bitmap %.3f MB", total_words * sizeof(uint64_t) / 1e6);
+        REPORT("\n");
+
+        double bytes_time = run_partitioned(threads, ids, LAYOUT_BYTES, array_offsets, total_elements);
+        REPORT("> Compact uint8_t execution time: %.6f seconds\n", bytes_time);
+        REPORT("> Compact uint8_t bandwidth: %.3f GB/s\n", get_bandwidth(bytes_time, (double)total_elements));
+        compact_ok = same_counts(serial_counts, partitioned_counts);
+
+        if (bitmaps) {
+            double bitmap_time = run_partitioned(threads, ids, LAYOUT_BITMAP, word_offsets, total_words);
+            REPORT("> Bitmap popcount execution time: %.6f seconds\n", bitmap_time);
+            REPORT("> Bitmap popcount bandwidth: %.3f GB/s\n", get_bandwidth(bitmap_time, total_words * sizeof(uint64_t)));
+            compact_ok = compact_ok && same_counts(serial_counts, partitioned_counts);
+        }
+
+        for (int a = 0; a < num_arrays; a++) {
+            free(byte_arrays[a]);
+            if (bitmaps) free(bitmaps[a]);
+        }
+        free(byte_arrays);
+        free(bitmaps);
+        free(word_offsets);
+    }
+
+    // STEP 7 (-F): all the statistics in one pass, then each one added to the pass in turn
+    // against a pass of its own
+    int fused_ok = 1;
+    if (fused) {
+        segments = (struct segment_stats*)aligned_alloc(CACHE_LINE, (size_t)num_threads * num_arrays * sizeof(struct segment_stats));
+        struct segment_stats *stats = (struct segment_stats*)malloc(num_arrays * sizeof(struct segment_stats));
+        struct segment_stats *reference = (struct segment_stats*)malloc(num_arrays * sizeof(struct segment_stats));
+
+        double fused_all = run_fused(threads, ids, STAT_ALL, stats);
+        REPORT("> Fused statistics pass (all %d): %.6f seconds\n", STAT_COUNT, fused_all);
+
+        // Check against a serial pass per array and the nonzero counts
+        for (int a = 0; a < num_arrays; a++) {
+            fused_pass(arrays[a], array_sizes[a], STAT_ALL, &reference[a]);
+            int same = stats[a].sum == reference[a].sum && stats[a].runs == reference[a].runs &&
+                       stats[a].longest == reference[a].longest && stats[a].len == reference[a].len;
+            if (array_sizes[a] > 0) same = same && stats[a].min == reference[a].min && stats[a].max == reference[a].max;
+            for (int v = 0; v < 10; v++) same = same && stats[a].hist[v] == reference[a].hist[v];
+            same = same && stats[a].len - stats[a].hist[0] == serial_counts[a];
+            fused_ok = fused_ok && same;
+        }
+        if (num_arrays > 0 && array_sizes[0] > 0) {
+            REPORT("> Array 0: histogram");
+            for (int v = 0; v < 10; v++) REPORT(" %lld", stats[0].hist[v]);
+            REPORT(", sum %lld, min %d, max %d, %lld runs (longest %lld)\n",
+                   stats[0].sum, stats[0].min, stats[0].max, stats[0].runs, stats[0].longest);
+        }
+
+        double previous = 0, separate_total = 0;
+        unsigned mask = 0;
+        for (int k = 0; k < STAT_COUNT; k++) {
+            mask |= 1u << k;
+            double with = run_fused(threads, ids, mask, stats);
+            double alone = run_fused(threads, ids, 1u << k, stats);
+            separate_total += alone;
+            REPORT("> + %-9s fused pass %.6f s (adds %.6f s), separate pass %.6f s\n",
+                   stat_names[k], with, with - previous, alone);
+            previous = with;
+        }
+        REPORT("> Fused pass %.6f s against %.6f s for %d separate passes\n", previous, separate_total, STAT_COUNT);
+
+        free(segments);
+        free(stats);
+        free(reference);
+    }
+
+    // STEP 8 (-W): num_threads writers update random elements through the sharded counts
+    // while one reader keeps querying them; afterwards the counts must match a recount
+    int live_ok = 1;
+    if (updates_per_writer > 0) {
+        live_stats_init(&live, num_threads, serial_counts);
+        atomic_store(&writers_running, num_threads);
+        pthread_t reader;
+        struct reader_result reads;
+        pthread_create(&reader, NULL, live_reader, &reads);
+
+        double begin_ns = get_time_ns();
+        for (int t = 0; t < num_threads; t++) {
+            ids[t] = t;
+            pthread_create(&threads[t], NULL, live_writer, &ids[t]);
+        }
+        for (int t = 0; t < num_threads; t++) {
+            pthread_join(threads[t], NULL);
+        }
+        double write_seconds = (get_time_ns() - begin_ns) / 1e9;
+        pthread_join(reader, NULL);
+
+        double total_updates = (double)updates_per_writer * num_threads;
+        REPORT("> Writer throughput (%d writers): %.0f updates/second\n", num_threads,
+               (write_seconds > 0) ? total_updates / write_seconds : 0.0);
+        REPORT("> Query latency (all %d arrays): mean %.0f ns, max %.0f ns over %lld queries (full recount: %.0f ns)\n",
+               num_arrays, reads.queries ? reads.total_ns / reads.queries : 0.0, reads.max_ns, reads.queries, simd_time * 1e9);
+
+        long long *recount = (long long*)malloc(num_arrays * sizeof(long long));
+        long long *merged = (long long*)malloc(num_arrays * sizeof(long long));
+        serial_count(recount);
+        for (int a = 0; a < num_arrays; a++) merged[a] = live_stats_query(&live, a);
+        if (DEBUG) print_counts("Incremental", merged);
+        live_ok = same_counts(recount, merged);
+        free(recount);
+        free(merged);
+        free(live.shards);
+    }
+
+    int all_ok = parallel_ok && simd_ok && compact_ok && fused_ok && live_ok;
+    if (csv_mode) {
+        printf("%d,%d,%d,%s,%d,%d,%.8f,%.8f,%.8f,%.8f,%d\n", array_size, num_arrays, num_threads,
+               stats_layout_names[stats_layout], (stats_layout == STATS_PADDED) ? stats_pad : stats_stride - (int)sizeof(long long int),
+               stats_stride, creation_time, serial_time, parallel_time, simd_time, all_ok);
+    }
+    if (all_ok) {
+        REPORT("> Status: SUCCESS - Serial and parallel results are correct!\n");
     } else {
-        printf("> Status: ERROR - Serial and parallel results are different!\n");
+        REPORT("> Status: ERROR - Serial and parallel results are different!\n");
     }
-    printf("\n");
+    REPORT("\n");
 
     // Cleanup - Free memory
-    free(array_0);
-    free(array_1);
-    free(array_2);
-    free(array_3);
-    
+    for (int a = 0; a < num_arrays; a++) free(arrays[a]);
+    free(arrays);
+    free(array_sizes);
+    free(array_offsets);
+    free(array_stats);
+    free(partials);
+    free(partitioned_counts);
+    free(serial_counts);
+    free(parallel_counts);
+    free(threads);
+    free(ids);
+
     return 0;
 }
 
 
 // PARALLEL IMPLEMENTATION
-// --- Thread function to count non-zero elements in an array
+// --- Thread function to count non-zero elements in one array (one thread per array)
 void* count_nonzero(void *arg) {
 
-    int thread_id = *(int*)arg;  // Which array (0, 1, 2, or 3)
-    
-    // Select the appropriate array based on thread_id
-    int *my_array;
-    if (thread_id == 0) my_array = array_0;
-    else if (thread_id == 1) my_array = array_1;
-    else if (thread_id == 2) my_array = array_2;
-    else my_array = array_3;
-    
-    // Count non-zero elements
+    int thread_id = *(int*)arg;  // Which array
+    int *my_array = arrays[thread_id];
+
+    // Count non-zero elements, updating the shared structure on every hit
+    // (or a local on this thread's stack with -L stack)
     int i;
-    for (i = 0; i < array_size; i++) {
-        if (my_array[i] != 0) {
-            // Update the correct field based on thread_id
-            if (thread_id == 0) array_stats.info_array_0++;
-            else if (thread_id == 1) array_stats.info_array_1++;
-            else if (thread_id == 2) array_stats.info_array_2++;
-            else array_stats.info_array_3++;
+    if (stats_layout == STATS_STACK) {
+        long long int local = 0;
+        for (i = 0; i < array_sizes[thread_id]; i++) {
+            if (my_array[i] != 0) {
+                local++;
+            }
+        }
+        ARRAY_STAT(thread_id) = local;
+    } else {
+        long long int *count = &ARRAY_STAT(thread_id);
+        for (i = 0; i < array_sizes[thread_id]; i++) {
+            if (my_array[i] != 0) {
+                (*count)++;
+            }
         }
     }
-    
+
     return NULL;
 }
 
-// SERIAL IMPLEMENTATION
-void serial_count(long long *result_0, long long *result_1, long long *result_2, long long *result_3) {
-    
-    int i;
-    *result_0 = 0;
-    *result_1 = 0;
-    *result_2 = 0;
-    *result_3 = 0;
-    
-    // Count for each array separately
-    for (i = 0; i < array_size; i++) {
-        if (array_0[i] != 0) (*result_0)++;
+// --- Thread function of the partitioned step: count this thread's span of the current layout
+void* count_nonzero_partitioned(void *arg) {
+
+    int thread_id = *(int*)arg;
+    long long begin = pass_total * thread_id / num_threads;
+    long long finish = pass_total * (thread_id + 1) / num_threads;
+    long long *my_partials = partials + (long long)thread_id * partial_stride;
+
+    // Walk the arrays that overlap [begin, finish); one store per array touched
+    for (int a = 0; a < num_arrays; a++) {
+        long long lo = (begin > pass_offsets[a]) ? begin : pass_offsets[a];
+        long long hi = (finish < pass_offsets[a + 1]) ? finish : pass_offsets[a + 1];
+        long long nonzero = 0;
+        if (lo < hi) {
+            lo -= pass_offsets[a];
+            hi -= pass_offsets[a];
+            if (pass_layout == LAYOUT_BITMAP) nonzero = popcount_kernel(bitmaps[a] + lo, hi - lo);
+            else if (pass_layout == LAYOUT_BYTES) nonzero = count_bytes_kernel(byte_arrays[a] + lo, hi - lo);
+            else nonzero = count_kernel(arrays[a] + lo, (int)(hi - lo));
+        }
+        my_partials[a] = nonzero;
     }
-    for (i = 0; i < array_size; i++) {
-        if (array_1[i] != 0) (*result_1)++;
+
+    // Lock-free reduction: the last thread to arrive sees every other row (acq_rel
+    // orders the rows written before each increment) and sums them
+    if (atomic_fetch_add_explicit(&threads_done, 1, memory_order_acq_rel) == num_threads - 1) {
+        for (int a = 0; a < num_arrays; a++) {
+            long long sum = 0;
+            for (int t = 0; t < num_threads; t++) {
+                sum += partials[(long long)t * partial_stride + a];
+            }
+            partitioned_counts[a] = sum;
+        }
     }
-    for (i = 0; i < array_size; i++) {
-        if (array_2[i] != 0) (*result_2)++;
+
+    return NULL;
+}
+
+// --- Writer of step 8: random writes of values 0-9 to random elements, through shard thread_id
+void* live_writer(void *arg) {
+
+    int thread_id = *(int*)arg;
+    uint64_t key = crng_key(time(NULL), 1000 + thread_id);
+
+    for (long long k = 0; k < updates_per_writer; k++) {
+        int a = (int)crng_below(key, 3 * k, num_arrays);
+        if (array_sizes[a] == 0) continue;
+        int i = (int)crng_below(key, 3 * k + 1, array_sizes[a]);
+        live_stats_write(&live, thread_id, a, i, crng_int_in(key, 3 * k + 2, 0, 9));
     }
-    for (i = 0; i < array_size; i++) {
-        if (array_3[i] != 0) (*result_3)++;
+
+    atomic_fetch_sub(&writers_running, 1);
+    return NULL;
+}
+
+// --- Reader of step 8: query every array's count until the writers are done
+void* live_reader(void *arg) {
+
+    struct reader_result *result = (struct reader_result*)arg;
+    volatile long long sink = 0;
+    result->queries = 0;
+    result->total_ns = 0;
+    result->max_ns = 0;
+
+    while (atomic_load(&writers_running) > 0) {
+        double begin = get_time_ns();
+        for (int a = 0; a < num_arrays; a++) sink += live_stats_query(&live, a);
+        double elapsed = get_time_ns() - begin;
+        result->queries++;
+        result->total_ns += elapsed;
+        if (elapsed > result->max_ns) result->max_ns = elapsed;
+    }
+
+    (void)sink;
+    return NULL;
+}
+
+// --- Worker of the fused step: summarize this thread's span of every array it overlaps
+void* fused_worker(void *arg) {
+
+    int thread_id = *(int*)arg;
+    long long begin = total_elements * thread_id / num_threads;
+    long long finish = total_elements * (thread_id + 1) / num_threads;
+    struct segment_stats *my_segments = segments + (long long)thread_id * num_arrays;
+
+    for (int a = 0; a < num_arrays; a++) {
+        long long lo = (begin > array_offsets[a]) ? begin : array_offsets[a];
+        long long hi = (finish < array_offsets[a + 1]) ? finish : array_offsets[a + 1];
+        if (lo < hi) fused_pass(arrays[a] + (lo - array_offsets[a]), hi - lo, fused_mask, &my_segments[a]);
+        else my_segments[a].len = 0;
+    }
+
+    return NULL;
+}
+
+// SERIAL IMPLEMENTATION
+void serial_count(long long *results) {
+
+    int i;
+
+    // Count for each array separately
+    for (int a = 0; a < num_arrays; a++) {
+        results[a] = 0;
+        for (i = 0; i < array_sizes[a]; i++) {
+            if (arrays[a][i] != 0) results[a]++;
+        }
     }
 }
 
@@ -213,4 +986,9 @@ void serial_count(long long *result_0, long long *result_1, long long *result_2,
 double get_time_diff(struct timeval start, struct timeval end) {
     return (end.tv_sec - start.tv_sec) + 
            (end.tv_usec - start.tv_usec) / 1000000.0;
-}
\ No newline at end of file
+}
+
+// Bandwidth in GB/s of one pass over the given number of bytes taking the given time
+double get_bandwidth(double seconds, double bytes) {
+    return (seconds > 0) ? bytes / seconds / 1e9 : 0.0;
+}
@@ -3,14 +3,28 @@
 #endif
 
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <sys/time.h>
 #include <time.h>
 
+#include "counter_rng.h"
+
 #define SEED 4
 #define DEBUG 0
 #define CRITICAL_SECTION_DELAY 100000
+#define CACHE_LINE 64
+#define SPIN_BACKOFF_MIN 4              // TTAS backoff, in pause instructions, doubled per failed attempt
+#define SPIN_BACKOFF_MAX 1024
+#define SPIN_YIELD_AFTER 1024           // Waits this long give the CPU away (a preempted holder would stall us)
+#define FC_MAX_PASSES 4                 // Flat combining: scans of the slots per combiner turn
+#define RING_SIZE 256                   // Sharded bank: messages per SPSC ring (power of two)
+#define SHARD_POLL_EVERY 16             // Sharded bank: own transactions between two inbox polls
 // #define USE_DELAY 0
 
 // Global data
@@ -20,14 +34,140 @@ int num_threads;
 int transactions_per_thread;
 float query_percentage;
 
-int lock_type;                          // 1=coarse mutex, 2=fine mutex, 3=coarse rwlock, 4=fine rwlock
+int lock_type;                          // 1=coarse mutex, 2=fine mutex, 3=coarse rwlock, 4=fine rwlock, 5=atomic, 6=seqlock,
+                                        // 7/8=coarse/fine TTAS, 9/10=coarse/fine ticket, 11/12=coarse/fine MCS,
+                                        // 13=flat combining, 14=sharded (message passing)
 int use_delay;                          // 0=no delay, 1=add delay to balance queries
 
 // Locks for different schemes
 pthread_mutex_t coarse_mutex;           // Single lock for all accounts
-pthread_mutex_t *fine_mutexes;          // One lock per account
 pthread_rwlock_t coarse_rwlock;         // Single rwlock for all accounts
-pthread_rwlock_t *fine_rwlocks;         // One rwlock per account
+atomic_int *atomic_accounts;            // Balances of lock_type 5 (lock-free), replace accounts while it runs
+
+// Seqlock (lock_type 6): account i belongs to stripe i % num_stripes. A transfer takes
+// the writer mutex of its stripes and makes their sequence numbers odd while it changes
+// the balances; a query reads the sequence, the balance and the sequence again, and
+// retries if a transfer was running or ran in between. Queries never write shared memory.
+struct seq_stripe {
+    atomic_uint seq;                    // Odd while a transfer is changing the stripe
+    pthread_mutex_t writer;             // Serializes the transfers of the stripe
+};
+struct seq_stripe *seq_stripes;
+int num_stripes = 0;                    // -s: stripes of lock_type 6 and of the striped layout, 0 = one per account
+
+// Layout of the fine-grained locks (lock_type 2 and 4), -l:
+// packed:  accounts[] and the lock array are plain arrays, so up to 16 balances and one or
+//          two locks share each cache line and transfers on neighbouring accounts false-share.
+// padded:  balance i and its lock sit together on their own cache line (one miss per account).
+// striped: balances stay packed, account i is guarded by lock i % num_stripes of a table of
+//          num_stripes locks padded to a cache line each, so the lock memory is bounded by -s.
+#define LAYOUT_PACKED  0
+#define LAYOUT_PADDED  1
+#define LAYOUT_STRIPED 2
+static const char *layout_names[] = { "packed", "padded", "striped" };
+int layout = LAYOUT_PACKED;
+
+struct padded_account_mutex {
+    _Alignas(CACHE_LINE) pthread_mutex_t lock;
+    int balance;
+};
+struct padded_account_rwlock {
+    _Alignas(CACHE_LINE) pthread_rwlock_t lock;
+    int balance;
+};
+struct padded_mutex {
+    _Alignas(CACHE_LINE) pthread_mutex_t lock;
+};
+struct padded_rwlock {
+    _Alignas(CACHE_LINE) pthread_rwlock_t lock;
+};
+
+// Balance i is at balance_base + i * balance_stride and its fine lock at
+// lock_base + lock_slot(i) * lock_stride, whatever the layout
+char *balance_base;
+size_t balance_stride;
+char *lock_base;                        // Fine mutexes or rwlocks (one per account, or per stripe)
+size_t lock_stride;
+int num_locks;
+#define BALANCE(i) (*(int*)(balance_base + (size_t)(i) * balance_stride))
+#define LOCK_AT(slot) ((void*)(lock_base + (size_t)(slot) * lock_stride))
+#define FINE_MUTEX(slot) ((pthread_mutex_t*)LOCK_AT(slot))
+#define FINE_RWLOCK(slot) ((pthread_rwlock_t*)LOCK_AT(slot))
+static inline int lock_slot(int account) {
+    return (layout == LAYOUT_STRIPED) ? account % num_stripes : account;
+}
+
+// User-space spinlocks (lock_type 7-12), one per cache line: a single one for the coarse
+// types, one per account for the fine types. Each kind only uses its own fields.
+// TTAS:   spin reading `word` until free, then try to take it with an exchange; every failed
+//         attempt doubles a pause backoff so that waiters stop hammering the line together.
+// Ticket: take a ticket from `word`, wait until `serving` reaches it (FIFO, one shared line).
+// MCS:    append a node to the queue at `tail` and spin on a flag of that node only; the
+//         holder hands the lock to its successor by clearing the successor's flag.
+#define SPIN_TTAS   0
+#define SPIN_TICKET 1
+#define SPIN_MCS    2
+struct mcs_node {
+    _Alignas(CACHE_LINE) _Atomic(struct mcs_node*) next;
+    atomic_int locked;
+};
+struct spin_lock {
+    _Alignas(CACHE_LINE) atomic_uint word;  // TTAS: 1 while held; ticket: next ticket to hand out
+    atomic_uint serving;                    // Ticket: ticket that holds the lock
+    _Atomic(struct mcs_node*) tail;         // MCS: last node of the queue, NULL when free
+};
+struct spin_lock *spin_locks;
+static _Thread_local struct mcs_node mcs_nodes[2]; // A transfer holds up to two MCS locks
+#define SPIN_KIND ((lock_type - 7) / 2)
+#define SPIN_FINE ((lock_type - 7) % 2)
+
+// Flat combining (lock_type 13): each thread publishes its transfer or query in its own
+// slot and waits. Whichever waiter takes the combiner flag applies every pending request of
+// all slots in one pass, so the balances stay in one core's cache and the other threads
+// spin on their own slot instead of on a shared lock; the combiner writes query results back
+// into the slots. Only the combiner touches the balances and the batch counters.
+#define FC_TRANSFER 0
+#define FC_QUERY    1
+struct fc_slot {
+    _Alignas(CACHE_LINE) atomic_int pending; // 1 from publication until the combiner applied it
+    int op;                                  // FC_TRANSFER or FC_QUERY
+    int from, to, amount;                    // A query reads `from`
+    int result;                              // Balance of a query
+};
+struct fc_slot *fc_slots;               // One per thread
+_Alignas(CACHE_LINE) atomic_int fc_combining; // 1 while a thread is the combiner
+static _Thread_local struct fc_slot *my_fc_slot;
+long fc_batches, fc_applied;            // Combiner turns that applied something, requests applied
+
+// Sharded bank (lock_type 14): worker t owns accounts [shard_start(t), shard_start(t + 1)) and
+// is the only thread that writes them. A transfer runs in two phases: the owner of `from`
+// debits it (DEBIT message if that is another worker), then the owner of `to` credits it
+// (CREDIT message if that is another worker). Worker s sends to worker d over ring s * T + d,
+// a single-producer single-consumer ring, so no two threads ever write the same index.
+// Queries of a foreign shard read the balance without writing anything.
+// Money in flight sits in a message; a message stays in its ring until it is fully handled
+// (a DEBIT's CREDIT is sent first), and main() runs only after every worker saw the bank
+// quiescent: all workers done and, reading all `completed` before all `sent`, equal sums.
+#define MSG_DEBIT  0
+#define MSG_CREDIT 1
+struct shard_msg {
+    int type;                           // MSG_DEBIT or MSG_CREDIT
+    int from, to, amount;
+};
+struct spsc_ring {
+    _Alignas(CACHE_LINE) atomic_uint head;  // Next message to consume, written by the consumer
+    unsigned cached_tail;                   // Consumer's last view of tail
+    _Alignas(CACHE_LINE) atomic_uint tail;  // Next free slot, written by the producer
+    unsigned cached_head;                   // Producer's last view of head
+    _Alignas(CACHE_LINE) struct shard_msg slots[RING_SIZE];
+};
+struct shard_worker {
+    _Alignas(CACHE_LINE) atomic_long sent;  // Messages created by this worker (read by all)
+    atomic_long completed;                  // Messages this worker fully handled
+    atomic_int done;                        // 1 once its own transactions are issued
+};
+struct spsc_ring *rings;                // num_threads * num_threads, [src * T + dst]
+struct shard_worker *shard_workers;
 
 
 // --- Function declarations ---
@@ -48,6 +188,21 @@ int query_coarse_rwlock(int account);
 // Fine-grained (per-account rwlock) API
 void transfer_fine_rwlock(int from, int to, int amount);
 int query_fine_rwlock(int account);
+// Lock-free (atomic balances) API
+void transfer_atomic(int from, int to, int amount);
+int query_atomic(int account);
+// Seqlock (optimistic queries) API
+void transfer_seqlock(int from, int to, int amount);
+int query_seqlock(int account);
+// Spinlock (TTAS, ticket, MCS; coarse or per-account) API
+void transfer_spin(int from, int to, int amount);
+int query_spin(int account);
+// Flat combining API
+void transfer_combining(int from, int to, int amount);
+int query_combining(int account);
+// Sharded (message passing) API
+void* threads_sharded(void* arg);
+long bank_total();
 
 
 int main (int argc, char *argv[]) {
@@ -68,10 +223,14 @@ int main (int argc, char *argv[]) {
     // num_threads = atoi(argv[5]);
     // use_delay = USE_DELAY;
 
-    if (argc != 6 && argc != 7) {
-        printf("Usage: %s <num_accounts> <transactions_per_thread> <query_percentage> <lock_type> <num_threads> [use_delay]\n", argv[0]);
-        printf("  lock_type: 1=coarse mutex, 2=fine mutex, 3=coarse rwlock, 4=fine rwlock\n");
+    if (argc < 6) {
+        printf("Usage: %s <num_accounts> <transactions_per_thread> <query_percentage> <lock_type> <num_threads> [use_delay] [-s stripes] [-l layout]\n", argv[0]);
+        printf("  lock_type: 1=coarse mutex, 2=fine mutex, 3=coarse rwlock, 4=fine rwlock, 5=atomic (lock-free), 6=seqlock\n");
+        printf("             7=coarse TTAS, 8=fine TTAS, 9=coarse ticket, 10=fine ticket, 11=coarse MCS, 12=fine MCS (spinlocks)\n");
+        printf("             13=flat combining, 14=sharded accounts with message-passing transfers\n");
         printf("  use_delay: 0=no delay (default), 1=add delay to queries\n");
+        printf("  -s: sequence counter stripes of the seqlock, or lock stripes of -l striped (default: one per account)\n");
+        printf("  -l packed|padded|striped: layout of the fine-grained locks of lock_type 2 and 4 (default: packed)\n");
         printf("Example: %s 100 1000 20 1 4\n", argv[0]);
         return 1;
     }
@@ -83,15 +242,45 @@ int main (int argc, char *argv[]) {
     query_percentage = atof(argv[3]) / 100.0;
     lock_type = atoi(argv[4]);
     num_threads = atoi(argv[5]);
-    use_delay = (argc == 7) ? atoi(argv[6]) : 0; // If 7th arg provided, use it; else default to 0
+    use_delay = 0;
+    optind = 6;
+    if (argc > 6 && argv[6][0] != '-') { // If 7th arg provided, use it; else default to 0
+        use_delay = atoi(argv[6]);
+        optind = 7;
+    }
+    int opt;
+    while ((opt = getopt(argc, argv, "s:l:")) != -1) {
+        switch (opt) {
+            case 's': num_stripes = atoi(optarg); break;
+            case 'l':
+                for (layout = 2; layout >= 0 && strcmp(optarg, layout_names[layout]) != 0; --layout);
+                if (layout < 0) {
+                    fprintf(stderr, "Unknown layout %s (packed, padded or striped).\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr, "Unknown option.\n");
+                return 1;
+        }
+    }
 
     // Validation of input num_accounts, transactions_per_thread, num_threads, lock_type, use_delay, query_percentage
     if (num_accounts <= 0 || transactions_per_thread <= 0 || num_threads <= 0) {
         fprintf(stderr, "num_accounts, transactions_per_thread, and num_threads must be positive integers.\n");
         return 1;
     }
-    if (lock_type < 1 || lock_type > 4) {
-        fprintf(stderr, "Invalid lock_type. Must be 1, 2, 3, or 4.\n");
+    if (lock_type < 1 || lock_type > 14) {
+        fprintf(stderr, "Invalid lock_type. Must be between 1 and 14.\n");
+        return 1;
+    }
+    if (num_stripes < 0) {
+        fprintf(stderr, "Invalid stripes. Must be 0 (one per account) or positive.\n");
+        return 1;
+    }
+    if (num_stripes == 0 || num_stripes > num_accounts) num_stripes = num_accounts;
+    if (layout != LAYOUT_PACKED && lock_type != 2 && lock_type != 4) {
+        fprintf(stderr, "The padded and striped layouts apply to the fine-grained locks (lock_type 2 and 4).\n");
         return 1;
     }
     if (use_delay < 0 || use_delay > 1) {
@@ -109,24 +298,28 @@ int main (int argc, char *argv[]) {
     printf("Transactions per thread: %d\n", transactions_per_thread);
     printf("Query percentage: %.1f %%\n", query_percentage * 100);
     printf("Lock type: %s\n", get_lock_name());
+    if (lock_type == 6) printf("Stripes: %d\n", num_stripes);
+    if (lock_type == 2 || lock_type == 4) printf("Layout: %s\n", layout_names[layout]);
     printf("Threads: %d\n", num_threads);
     printf("Use delay: %s\n", use_delay ? "Yes" : "No");
 
-    srand(time(NULL));
-    // srand(SEED); // For reproducibility   
+    uint64_t rng_seed = time(NULL);
+    // uint64_t rng_seed = SEED; // For reproducibility
 
     // STEP 1: Allocate and initialize bank accounts array ----
     accounts = (int *)malloc(num_accounts * sizeof(int));
-    for (int i = 0; i < num_accounts; ++i) {
-        accounts[i] = rand() % 10000; // [0, 9999]
-    }
+    crng_fill_ints(accounts, num_accounts, rng_seed, 0, 0, 9999, num_threads); // [0, 9999]
 
     // STEP 2: Initialize locks ----
     init_locks();
 
+    if (lock_type == 2 || lock_type == 4) {
+        printf("Lock table: %d locks, %zu bytes per lock, %.1f KB\n",
+               num_locks, lock_stride, (double)num_locks * lock_stride / 1024.0);
+    }
+
     // STEP 3: Precompute initial total amount from all accounts ------
-    long initial_total = 0;
-    for (int i = 0; i < num_accounts; ++i) initial_total += accounts[i];
+    long initial_total = bank_total();
 
     // STEP 4: Start timing and create threads ----
     struct timeval start, end;
@@ -136,7 +329,7 @@ int main (int argc, char *argv[]) {
     long thread;
 
     for (thread = 0; thread < num_threads; thread++) {
-        pthread_create(&threads[thread], NULL, threads_transactions, (void*) thread);
+        pthread_create(&threads[thread], NULL, (lock_type == 14) ? threads_sharded : threads_transactions, (void*) thread);
     }
     // Wait for all threads to complete
     for (thread = 0; thread < num_threads; thread++) {
@@ -147,8 +340,7 @@ int main (int argc, char *argv[]) {
 
 
     // STEP 5: Compute final total amount and timing ----
-    long final_total = 0;
-    for (int i = 0; i < num_accounts; ++i) final_total += accounts[i];
+    long final_total = bank_total();
 
 
     // STEP 6: Print results ----
@@ -165,6 +357,9 @@ int main (int argc, char *argv[]) {
     double time_taken = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
     printf("> Execution time: %.6f seconds\n", time_taken);
     printf("> Throughput: %.2f transactions/second\n", (num_threads * transactions_per_thread) / time_taken);
+    if (lock_type == 13 && fc_batches > 0) {
+        printf("> Combining: %ld batches, %.2f requests per batch\n", fc_batches, (double)fc_applied / fc_batches);
+    }
     printf("\n");
 
     // ---- Cleanup - Free memory
@@ -183,6 +378,7 @@ void* threads_transactions(void* arg) {
     
     long thread_id = (long)arg;
     unsigned int seed = time(NULL) ^ thread_id;
+    if (lock_type == 13) my_fc_slot = &fc_slots[thread_id];
     
     for (int t = 0; t < transactions_per_thread; t++) {
 
@@ -198,6 +394,10 @@ void* threads_transactions(void* arg) {
                 case 2: balance = query_fine_mutex(acc); break;
                 case 3: balance = query_coarse_rwlock(acc); break;
                 case 4: balance = query_fine_rwlock(acc); break;
+                case 5: balance = query_atomic(acc); break;
+                case 6: balance = query_seqlock(acc); break;
+                case 7: case 8: case 9: case 10: case 11: case 12: balance = query_spin(acc); break;
+                case 13: balance = query_combining(acc); break;
                 default: balance = query_coarse_mutex(acc); break;
             }
 
@@ -220,6 +420,10 @@ void* threads_transactions(void* arg) {
                 case 2: transfer_fine_mutex(from, to, amount); break;
                 case 3: transfer_coarse_rwlock(from, to, amount); break;
                 case 4: transfer_fine_rwlock(from, to, amount); break;
+                case 5: transfer_atomic(from, to, amount); break;
+                case 6: transfer_seqlock(from, to, amount); break;
+                case 7: case 8: case 9: case 10: case 11: case 12: transfer_spin(from, to, amount); break;
+                case 13: transfer_combining(from, to, amount); break;
                 default: transfer_coarse_mutex(from, to, amount); break;
             }
             
@@ -240,9 +444,9 @@ void transfer_coarse_mutex(int from, int to, int amount) {
     if (from < 0 || to < 0 || from >= num_accounts || to >= num_accounts) return; // Invalid accounts
 
     pthread_mutex_lock(&coarse_mutex);
-    if (accounts[from] >= amount) {
-        accounts[from] -= amount;
-        accounts[to] += amount;
+    if (BALANCE(from) >= amount) {
+        BALANCE(from) -= amount;
+        BALANCE(to) += amount;
     }
     pthread_mutex_unlock(&coarse_mutex);
 }
@@ -251,7 +455,7 @@ int query_coarse_mutex(int account) {
     
     int balance;
     pthread_mutex_lock(&coarse_mutex);
-    balance = accounts[account];
+    balance = BALANCE(account);
     if (use_delay) { // Simulate delay inside critical section            
         for (volatile int i = 0; i < CRITICAL_SECTION_DELAY; i++);
     }
@@ -266,29 +470,31 @@ void transfer_fine_mutex(int from, int to, int amount) {
     if (from == to) return; // No self-transfer
     if (from < 0 || to < 0 || from >= num_accounts || to >= num_accounts) return; // Invalid accounts
 
-    // To avoid deadlock, always lock in order of account number
-    int first = (from < to) ? from : to;
-    int second = (from < to) ? to : from;
+    // To avoid deadlock, always lock in order of lock slot (the account number unless striped)
+    int s_from = lock_slot(from), s_to = lock_slot(to);
+    pthread_mutex_t *first = FINE_MUTEX((s_from < s_to) ? s_from : s_to);
+    pthread_mutex_t *second = FINE_MUTEX((s_from < s_to) ? s_to : s_from);
 
-    pthread_mutex_lock(&fine_mutexes[first]);
-    pthread_mutex_lock(&fine_mutexes[second]);
-    if (accounts[from] >= amount) {
-        accounts[from] -= amount;
-        accounts[to] += amount;
+    pthread_mutex_lock(first);
+    if (second != first) pthread_mutex_lock(second); // Both accounts in one stripe: lock once
+    if (BALANCE(from) >= amount) {
+        BALANCE(from) -= amount;
+        BALANCE(to) += amount;
     }
-    pthread_mutex_unlock(&fine_mutexes[second]);
-    pthread_mutex_unlock(&fine_mutexes[first]);
+    if (second != first) pthread_mutex_unlock(second);
+    pthread_mutex_unlock(first);
 }
 int query_fine_mutex(int account) {
     if (account < 0 || account >= num_accounts) return 0; // Invalid account
 
     int balance;
-    pthread_mutex_lock(&fine_mutexes[account]);
-    balance = accounts[account];
+    pthread_mutex_t *lock = FINE_MUTEX(lock_slot(account));
+    pthread_mutex_lock(lock);
+    balance = BALANCE(account);
     if (use_delay) { // Simulate delay inside critical section            
         for (volatile int i = 0; i < CRITICAL_SECTION_DELAY; i++);
     }
-    pthread_mutex_unlock(&fine_mutexes[account]);
+    pthread_mutex_unlock(lock);
 
     return balance;
 }
@@ -300,9 +506,9 @@ void transfer_coarse_rwlock(int from, int to, int amount) {
     if (from < 0 || to < 0 || from >= num_accounts || to >= num_accounts) return; // Invalid accounts
 
     pthread_rwlock_wrlock(&coarse_rwlock);
-    if (accounts[from] >= amount) {
-        accounts[from] -= amount;
-        accounts[to] += amount;
+    if (BALANCE(from) >= amount) {
+        BALANCE(from) -= amount;
+        BALANCE(to) += amount;
     }
     pthread_rwlock_unlock(&coarse_rwlock);
 }
@@ -311,7 +517,7 @@ int query_coarse_rwlock(int account) {
     
     int balance;
     pthread_rwlock_rdlock(&coarse_rwlock);
-    balance = accounts[account];
+    balance = BALANCE(account);
     if (use_delay) { // Simulate delay inside critical section            
         for (volatile int i = 0; i < CRITICAL_SECTION_DELAY; i++);
     }
@@ -326,37 +532,470 @@ void transfer_fine_rwlock(int from, int to, int amount) {
     if (from == to) return; // No self-transfer
     if (from < 0 || to < 0 || from >= num_accounts || to >= num_accounts) return; // Invalid accounts
 
-    // To avoid deadlock, always lock in order of account number
-    int first = (from < to) ? from : to;
-    int second = (from < to) ? to : from;
+    // To avoid deadlock, always lock in order of lock slot (the account number unless striped)
+    int s_from = lock_slot(from), s_to = lock_slot(to);
+    pthread_rwlock_t *first = FINE_RWLOCK((s_from < s_to) ? s_from : s_to);
+    pthread_rwlock_t *second = FINE_RWLOCK((s_from < s_to) ? s_to : s_from);
 
-    pthread_rwlock_wrlock(&fine_rwlocks[first]);
-    pthread_rwlock_wrlock(&fine_rwlocks[second]);
-    if (accounts[from] >= amount) {
-        accounts[from] -= amount;
-        accounts[to] += amount;
+    pthread_rwlock_wrlock(first);
+    if (second != first) pthread_rwlock_wrlock(second); // Both accounts in one stripe: lock once
+    if (BALANCE(from) >= amount) {
+        BALANCE(from) -= amount;
+        BALANCE(to) += amount;
     }
-    pthread_rwlock_unlock(&fine_rwlocks[second]);
-    pthread_rwlock_unlock(&fine_rwlocks[first]);
+    if (second != first) pthread_rwlock_unlock(second);
+    pthread_rwlock_unlock(first);
 }
 int query_fine_rwlock(int account) {
     if (account < 0 || account >= num_accounts) return 0; // Invalid account
 
     int balance;
-    pthread_rwlock_rdlock(&fine_rwlocks[account]);
-    balance = accounts[account];
+    pthread_rwlock_t *lock = FINE_RWLOCK(lock_slot(account));
+    pthread_rwlock_rdlock(lock);
+    balance = BALANCE(account);
     if (use_delay) { // Simulate delay inside critical section            
         for (volatile int i = 0; i < CRITICAL_SECTION_DELAY; i++);
     }
-    pthread_rwlock_unlock(&fine_rwlocks[account]);
+    pthread_rwlock_unlock(lock);
+
+    return balance;
+}
+
+// -------- Lock-free API (atomic balances) --------
+// The withdraw is a CAS loop that only succeeds while the balance covers the amount, so
+// no balance goes negative; the deposit is a plain fetch_add. Between the two the amount
+// is in flight and belongs to no account, so the total is only guaranteed at quiescence
+// (after the threads are joined), which is where main() checks it. Each balance only
+// needs atomicity, not ordering with the others, hence relaxed operations.
+void transfer_atomic(int from, int to, int amount) {
+    if (amount <= 0) return; // Invalid transfer
+    if (from == to) return; // No self-transfer
+    if (from < 0 || to < 0 || from >= num_accounts || to >= num_accounts) return; // Invalid accounts
+
+    int balance = atomic_load_explicit(&atomic_accounts[from], memory_order_relaxed);
+    do {
+        if (balance < amount) return; // Insufficient funds, nothing moved
+    } while (!atomic_compare_exchange_weak_explicit(&atomic_accounts[from], &balance, balance - amount,
+                                                    memory_order_relaxed, memory_order_relaxed));
+    atomic_fetch_add_explicit(&atomic_accounts[to], amount, memory_order_relaxed);
+}
+int query_atomic(int account) {
+    if (account < 0 || account >= num_accounts) return 0; // Invalid account
+
+    int balance = atomic_load_explicit(&atomic_accounts[account], memory_order_relaxed);
+    if (use_delay) { // Same work as the locked queries, but no lock is held
+        for (volatile int i = 0; i < CRITICAL_SECTION_DELAY; i++);
+    }
+
+    return balance;
+}
+
+// -------- Seqlock API --------
+// Balances are read and written with relaxed atomics so that a query racing a transfer
+// reads some value (and then retries) instead of being undefined behaviour.
+void transfer_seqlock(int from, int to, int amount) {
+    if (amount <= 0) return; // Invalid transfer
+    if (from == to) return; // No self-transfer
+    if (from < 0 || to < 0 || from >= num_accounts || to >= num_accounts) return; // Invalid accounts
+
+    // To avoid deadlock, always lock in order of stripe number
+    int s_from = from % num_stripes, s_to = to % num_stripes;
+    struct seq_stripe *first = &seq_stripes[(s_from < s_to) ? s_from : s_to];
+    struct seq_stripe *second = &seq_stripes[(s_from < s_to) ? s_to : s_from];
+
+    pthread_mutex_lock(&first->writer);
+    if (second != first) pthread_mutex_lock(&second->writer);
+
+    // Odd sequence: queries of these stripes will retry
+    atomic_store_explicit(&first->seq, atomic_load_explicit(&first->seq, memory_order_relaxed) + 1, memory_order_relaxed);
+    if (second != first) atomic_store_explicit(&second->seq, atomic_load_explicit(&second->seq, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    int balance = __atomic_load_n(&BALANCE(from), __ATOMIC_RELAXED);
+    if (balance >= amount) {
+        __atomic_store_n(&BALANCE(from), balance - amount, __ATOMIC_RELAXED);
+        __atomic_store_n(&BALANCE(to), __atomic_load_n(&BALANCE(to), __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+    }
+
+    // Even again, publishing the new balances
+    if (second != first) atomic_store_explicit(&second->seq, atomic_load_explicit(&second->seq, memory_order_relaxed) + 1, memory_order_release);
+    atomic_store_explicit(&first->seq, atomic_load_explicit(&first->seq, memory_order_relaxed) + 1, memory_order_release);
+
+    if (second != first) pthread_mutex_unlock(&second->writer);
+    pthread_mutex_unlock(&first->writer);
+}
+int query_seqlock(int account) {
+    if (account < 0 || account >= num_accounts) return 0; // Invalid account
+
+    struct seq_stripe *stripe = &seq_stripes[account % num_stripes];
+    unsigned before, after;
+    int balance;
+    do {
+        before = atomic_load_explicit(&stripe->seq, memory_order_acquire);
+        if (before & 1) continue; // A transfer is running, wait for it
+        balance = __atomic_load_n(&BALANCE(account), __ATOMIC_RELAXED);
+        if (use_delay) { // Simulate delay inside the read section (a transfer meanwhile means a retry)
+            for (volatile int i = 0; i < CRITICAL_SECTION_DELAY; i++);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&stripe->seq, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    return balance;
+}
+
+// -------- Spinlock API --------
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    atomic_signal_fence(memory_order_seq_cst);
+#endif
+}
+
+// One step of a wait loop: pause, and yield the CPU now and then
+static inline void spin_wait(int *spins) {
+    cpu_relax();
+    if (++*spins >= SPIN_YIELD_AFTER) {
+        *spins = 0;
+        sched_yield();
+    }
+}
+
+static void spin_acquire(struct spin_lock *lock, struct mcs_node *node) {
+    int spins = 0;
+    switch (SPIN_KIND) {
+        case SPIN_TTAS: {
+            unsigned backoff = SPIN_BACKOFF_MIN;
+            for (;;) {
+                while (atomic_load_explicit(&lock->word, memory_order_relaxed)) spin_wait(&spins);
+                if (!atomic_exchange_explicit(&lock->word, 1, memory_order_acquire)) return;
+                for (unsigned i = 0; i < backoff; i++) cpu_relax();
+                if (backoff < SPIN_BACKOFF_MAX) backoff <<= 1;
+                else sched_yield();
+            }
+        }
+        case SPIN_TICKET: {
+            unsigned ticket = atomic_fetch_add_explicit(&lock->word, 1, memory_order_relaxed);
+            while (atomic_load_explicit(&lock->serving, memory_order_acquire) != ticket) spin_wait(&spins);
+            return;
+        }
+        case SPIN_MCS: {
+            atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+            atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+            struct mcs_node *prev = atomic_exchange_explicit(&lock->tail, node, memory_order_acq_rel);
+            if (prev) { // Queue behind prev and wait for its hand-off
+                atomic_store_explicit(&prev->next, node, memory_order_release);
+                while (atomic_load_explicit(&node->locked, memory_order_acquire)) spin_wait(&spins);
+            }
+            return;
+        }
+    }
+}
+
+static void spin_release(struct spin_lock *lock, struct mcs_node *node) {
+    switch (SPIN_KIND) {
+        case SPIN_TTAS:
+            atomic_store_explicit(&lock->word, 0, memory_order_release);
+            return;
+        case SPIN_TICKET:
+            atomic_store_explicit(&lock->serving, atomic_load_explicit(&lock->serving, memory_order_relaxed) + 1,
+                                  memory_order_release);
+            return;
+        case SPIN_MCS: {
+            struct mcs_node *next = atomic_load_explicit(&node->next, memory_order_acquire);
+            if (!next) {
+                struct mcs_node *expected = node;
+                if (atomic_compare_exchange_strong_explicit(&lock->tail, &expected, NULL,
+                                                            memory_order_release, memory_order_relaxed)) {
+                    return; // No waiter
+                }
+                int spins = 0; // A waiter swapped itself in but has not linked yet
+                while (!(next = atomic_load_explicit(&node->next, memory_order_acquire))) spin_wait(&spins);
+            }
+            atomic_store_explicit(&next->locked, 0, memory_order_release);
+            return;
+        }
+    }
+}
+
+void transfer_spin(int from, int to, int amount) {
+    if (amount <= 0) return; // Invalid transfer
+    if (from == to) return; // No self-transfer
+    if (from < 0 || to < 0 || from >= num_accounts || to >= num_accounts) return; // Invalid accounts
+
+    // Coarse: lock 0 only. Fine: to avoid deadlock, always lock in order of account number
+    struct spin_lock *first = &spin_locks[SPIN_FINE ? ((from < to) ? from : to) : 0];
+    struct spin_lock *second = SPIN_FINE ? &spin_locks[(from < to) ? to : from] : NULL;
+
+    spin_acquire(first, &mcs_nodes[0]);
+    if (second) spin_acquire(second, &mcs_nodes[1]);
+    if (BALANCE(from) >= amount) {
+        BALANCE(from) -= amount;
+        BALANCE(to) += amount;
+    }
+    if (second) spin_release(second, &mcs_nodes[1]);
+    spin_release(first, &mcs_nodes[0]);
+}
+int query_spin(int account) {
+    if (account < 0 || account >= num_accounts) return 0; // Invalid account
+
+    struct spin_lock *lock = &spin_locks[SPIN_FINE ? account : 0];
+    int balance;
+    spin_acquire(lock, &mcs_nodes[0]);
+    balance = BALANCE(account);
+    if (use_delay) { // Simulate delay inside critical section
+        for (volatile int i = 0; i < CRITICAL_SECTION_DELAY; i++);
+    }
+    spin_release(lock, &mcs_nodes[0]);
 
     return balance;
 }
 
+// -------- Flat Combining API --------
+// Apply every pending request; called by the combiner only
+static void fc_combine() {
+    long turn = 0;
+    for (int pass = 0; pass < FC_MAX_PASSES; pass++) {
+        int applied = 0;
+        for (int t = 0; t < num_threads; t++) {
+            struct fc_slot *slot = &fc_slots[t];
+            if (!atomic_load_explicit(&slot->pending, memory_order_acquire)) continue;
+            if (slot->op == FC_QUERY) {
+                slot->result = BALANCE(slot->from);
+                if (use_delay) { // Simulate delay inside critical section
+                    for (volatile int i = 0; i < CRITICAL_SECTION_DELAY; i++);
+                }
+            } else if (BALANCE(slot->from) >= slot->amount) {
+                BALANCE(slot->from) -= slot->amount;
+                BALANCE(slot->to) += slot->amount;
+            }
+            atomic_store_explicit(&slot->pending, 0, memory_order_release); // Hand the result back
+            applied++;
+        }
+        if (applied == 0) break;
+        turn += applied;
+    }
+    if (turn > 0) { // One batch per combiner turn, whatever the number of passes
+        fc_batches++;
+        fc_applied += turn;
+    }
+}
+
+// Publish the request in the own slot, then wait until a combiner applied it, combining
+// ourselves whenever nobody else does
+static void fc_execute(struct fc_slot *slot) {
+    atomic_store_explicit(&slot->pending, 1, memory_order_release);
+    int spins = 0;
+    while (atomic_load_explicit(&slot->pending, memory_order_acquire)) {
+        if (!atomic_load_explicit(&fc_combining, memory_order_relaxed) &&
+            !atomic_exchange_explicit(&fc_combining, 1, memory_order_acquire)) {
+            fc_combine();
+            atomic_store_explicit(&fc_combining, 0, memory_order_release);
+        } else {
+            spin_wait(&spins);
+        }
+    }
+}
+
+void transfer_combining(int from, int to, int amount) {
+    if (amount <= 0) return; // Invalid transfer
+    if (from == to) return; // No self-transfer
+    if (from < 0 || to < 0 || from >= num_accounts || to >= num_accounts) return; // Invalid accounts
+
+    struct fc_slot *slot = my_fc_slot;
+    slot->op = FC_TRANSFER;
+    slot->from = from;
+    slot->to = to;
+    slot->amount = amount;
+    fc_execute(slot);
+}
+int query_combining(int account) {
+    if (account < 0 || account >= num_accounts) return 0; // Invalid account
+
+    struct fc_slot *slot = my_fc_slot;
+    slot->op = FC_QUERY;
+    slot->from = account;
+    fc_execute(slot);
+
+    return slot->result;
+}
+
+// -------- Sharded API (message passing) --------
+static inline int shard_owner(int account) {
+    return (int)(((long long)(account + 1) * num_threads - 1) / num_accounts);
+}
+
+// Messages for one destination that did not fit in its ring yet, kept by the sender in order
+struct msg_backlog {
+    struct shard_msg *msgs;
+    int head, len, cap;                 // Pending messages are msgs[head, len)
+};
+static _Thread_local struct msg_backlog *backlogs; // One per destination worker
+static _Thread_local long backlog_total;
+
+static int ring_push(struct spsc_ring *ring, const struct shard_msg *msg) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - ring->cached_head == RING_SIZE) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail - ring->cached_head == RING_SIZE) return 0; // Full
+    }
+    ring->slots[tail & (RING_SIZE - 1)] = *msg;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+// Send to worker dst, never blocking: a full ring (or older messages to flush) goes to the backlog
+static void shard_send(int me, int dst, int type, int from, int to, int amount) {
+    struct shard_msg msg = { type, from, to, amount };
+    atomic_store(&shard_workers[me].sent, atomic_load_explicit(&shard_workers[me].sent, memory_order_relaxed) + 1);
+    struct msg_backlog *b = &backlogs[dst];
+    if (b->head == b->len && ring_push(&rings[(size_t)me * num_threads + dst], &msg)) return;
+    if (b->len == b->cap) {
+        b->cap = b->cap ? 2 * b->cap : 64;
+        b->msgs = (struct shard_msg*)realloc(b->msgs, b->cap * sizeof(struct shard_msg));
+    }
+    b->msgs[b->len++] = msg;
+    backlog_total++;
+}
+
+// Push what fits of the backlogs, in order; returns the number of messages sent
+static int flush_backlog(int me) {
+    if (backlog_total == 0) return 0;
+    int flushed = 0;
+    for (int dst = 0; dst < num_threads; dst++) {
+        struct msg_backlog *b = &backlogs[dst];
+        while (b->head < b->len && ring_push(&rings[(size_t)me * num_threads + dst], &b->msgs[b->head])) {
+            b->head++;
+            flushed++;
+        }
+        if (b->head == b->len) b->head = b->len = 0;
+    }
+    backlog_total -= flushed;
+    return flushed;
+}
+
+// Phase 1, run by the owner of from: debit, then credit here or hand the amount to the owner of to
+static void shard_debit(int me, int from, int to, int amount) {
+    int balance = __atomic_load_n(&BALANCE(from), __ATOMIC_RELAXED);
+    if (balance < amount) return; // Insufficient funds, nothing moved
+    __atomic_store_n(&BALANCE(from), balance - amount, __ATOMIC_RELAXED);
+    int owner = shard_owner(to);
+    if (owner == me) {
+        __atomic_store_n(&BALANCE(to), __atomic_load_n(&BALANCE(to), __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+    } else {
+        shard_send(me, owner, MSG_CREDIT, from, to, amount);
+    }
+}
+
+// Handle every message sent to this worker; returns the number of messages handled or flushed
+static int shard_poll(int me) {
+    int flushed = flush_backlog(me);
+    int handled = 0;
+    for (int src = 0; src < num_threads; src++) {
+        struct spsc_ring *ring = &rings[(size_t)src * num_threads + me];
+        unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        for (; head != ring->cached_tail; head++) {
+            struct shard_msg *msg = &ring->slots[head & (RING_SIZE - 1)];
+            if (msg->type == MSG_DEBIT) { // Phase 1 on behalf of another worker
+                shard_debit(me, msg->from, msg->to, msg->amount);
+            } else { // Phase 2: the amount arrives
+                __atomic_store_n(&BALANCE(msg->to), __atomic_load_n(&BALANCE(msg->to), __ATOMIC_RELAXED) + msg->amount,
+                                 __ATOMIC_RELAXED);
+            }
+            handled++;
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+    }
+    if (handled) {
+        atomic_store(&shard_workers[me].completed,
+                     atomic_load_explicit(&shard_workers[me].completed, memory_order_relaxed) + handled);
+    }
+    return handled + flushed;
+}
+
+// All workers done and no message pending (see the comment of struct shard_worker)
+static int shard_quiescent() {
+    long completed = 0, sent = 0;
+    for (int t = 0; t < num_threads; t++) {
+        if (!atomic_load(&shard_workers[t].done)) return 0;
+    }
+    for (int t = 0; t < num_threads; t++) completed += atomic_load(&shard_workers[t].completed);
+    for (int t = 0; t < num_threads; t++) sent += atomic_load(&shard_workers[t].sent);
+    return completed == sent;
+}
+
+// Same transaction mix as threads_transactions(), applied by message passing
+void* threads_sharded(void* arg) {
+
+    long thread_id = (long)arg;
+    int me = (int)thread_id;
+    unsigned int seed = time(NULL) ^ thread_id;
+    backlogs = (struct msg_backlog*)calloc(num_threads, sizeof(struct msg_backlog));
+
+    for (int t = 0; t < transactions_per_thread; t++) {
+
+        float r = (float)rand_r(&seed) / RAND_MAX; // Random float in [0.0, 1.0)
+        if (r < query_percentage) { // Perform query (own or foreign shard, read only)
+            int acc = rand_r(&seed) % num_accounts;
+            int balance = __atomic_load_n(&BALANCE(acc), __ATOMIC_RELAXED);
+            if (use_delay) { // Same work as the locked queries
+                for (volatile int i = 0; i < CRITICAL_SECTION_DELAY; i++);
+            }
+
+            if (DEBUG) {
+                printf("Thread %ld: Queried account %d, balance = %d\n", thread_id, acc, balance);
+            }
+        } else { // Perform transfer
+            int from = rand_r(&seed) % num_accounts;
+            int to;
+            do { to = rand_r(&seed) % num_accounts; } while (to == from); // Ensure different accounts
+            int amount = rand_r(&seed) % 1000; // Random amount to transfer [0, 999]
+
+            if (amount > 0) {
+                int owner = shard_owner(from);
+                if (owner == me) shard_debit(me, from, to, amount);
+                else shard_send(me, owner, MSG_DEBIT, from, to, amount);
+            }
+
+            if (DEBUG) {
+                printf("Thread %ld: Transferred %d from account %d to account %d\n", thread_id, amount, from, to);
+            }
+        }
+
+        if ((t + 1) % SHARD_POLL_EVERY == 0) shard_poll(me);
+    }
+
+    // Keep serving the other shards until no money is in flight anywhere
+    atomic_store(&shard_workers[me].done, 1);
+    while (!(backlog_total == 0 && shard_quiescent())) {
+        if (!shard_poll(me)) sched_yield(); // Nothing to serve: let the busy workers run
+    }
+    for (int dst = 0; dst < num_threads; dst++) free(backlogs[dst].msgs);
+    free(backlogs);
+
+    return NULL;
+}
+
+// --- Sum of all balances (call while no transaction runs) ---
+long bank_total() {
+    long total = 0;
+    for (int i = 0; i < num_accounts; ++i) {
+        total += (lock_type == 5) ? atomic_load(&atomic_accounts[i]) : BALANCE(i);
+    }
+    return total;
+}
+
 
 // -------- Lock Management --------
 // --- Initialize locks based on lock_type ---
 void init_locks() {
+    // Balances live in accounts[] unless the padded layout moves them next to their locks
+    balance_base = (char*)accounts;
+    balance_stride = sizeof(int);
+    num_locks = (layout == LAYOUT_STRIPED) ? num_stripes : num_accounts;
+
     switch(lock_type) {
         case 1:
             // Coarse-grained mutex
@@ -364,9 +1003,18 @@ void init_locks() {
             break;
         case 2:
             // Fine-grained mutex
-            fine_mutexes = (pthread_mutex_t*)malloc(num_accounts * sizeof(pthread_mutex_t));
-            for (int i = 0; i < num_accounts; i++) {
-                pthread_mutex_init(&fine_mutexes[i], NULL);
+            switch (layout) {
+                case LAYOUT_PADDED: lock_stride = sizeof(struct padded_account_mutex); break;
+                case LAYOUT_STRIPED: lock_stride = sizeof(struct padded_mutex); break;
+                default: lock_stride = sizeof(pthread_mutex_t);
+            }
+            lock_base = (char*)aligned_alloc(CACHE_LINE, (num_locks * lock_stride + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE);
+            for (int i = 0; i < num_locks; i++) {
+                pthread_mutex_init(FINE_MUTEX(i), NULL);
+            }
+            if (layout == LAYOUT_PADDED) {
+                balance_base = lock_base + offsetof(struct padded_account_mutex, balance);
+                balance_stride = lock_stride;
             }
             break;
         case 3:
@@ -379,11 +1027,70 @@ void init_locks() {
                 pthread_rwlockattr_t attr;
                 pthread_rwlockattr_init(&attr);
                 pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
-                fine_rwlocks = (pthread_rwlock_t*)malloc(num_accounts * sizeof(pthread_rwlock_t));
-                for (int i = 0; i < num_accounts; i++) {
-                    pthread_rwlock_init(&fine_rwlocks[i], &attr);
+                switch (layout) {
+                    case LAYOUT_PADDED: lock_stride = sizeof(struct padded_account_rwlock); break;
+                    case LAYOUT_STRIPED: lock_stride = sizeof(struct padded_rwlock); break;
+                    default: lock_stride = sizeof(pthread_rwlock_t);
+                }
+                lock_base = (char*)aligned_alloc(CACHE_LINE, (num_locks * lock_stride + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE);
+                for (int i = 0; i < num_locks; i++) {
+                    pthread_rwlock_init(FINE_RWLOCK(i), &attr);
                 }
                 pthread_rwlockattr_destroy(&attr);
+                if (layout == LAYOUT_PADDED) {
+                    balance_base = lock_base + offsetof(struct padded_account_rwlock, balance);
+                    balance_stride = lock_stride;
+                }
+            }
+            break;
+        case 6:
+            // Seqlock: a sequence counter and a writer mutex per stripe
+            seq_stripes = (struct seq_stripe*)malloc(num_stripes * sizeof(struct seq_stripe));
+            for (int i = 0; i < num_stripes; i++) {
+                atomic_init(&seq_stripes[i].seq, 0);
+                pthread_mutex_init(&seq_stripes[i].writer, NULL);
+            }
+            break;
+        case 7: case 8: case 9: case 10: case 11: case 12:
+            // Spinlocks: one, or one per account, each on its own cache line
+            {
+                int count = SPIN_FINE ? num_accounts : 1;
+                spin_locks = (struct spin_lock*)aligned_alloc(CACHE_LINE, count * sizeof(struct spin_lock));
+                for (int i = 0; i < count; i++) {
+                    atomic_init(&spin_locks[i].word, 0);
+                    atomic_init(&spin_locks[i].serving, 0);
+                    atomic_init(&spin_locks[i].tail, NULL);
+                }
+            }
+            break;
+        case 13:
+            // Flat combining: a request slot per thread, each on its own cache line
+            fc_slots = (struct fc_slot*)aligned_alloc(CACHE_LINE, num_threads * sizeof(struct fc_slot));
+            for (int i = 0; i < num_threads; i++) {
+                atomic_init(&fc_slots[i].pending, 0);
+            }
+            atomic_init(&fc_combining, 0);
+            break;
+        case 14:
+            // Sharded: no locks, a ring per ordered pair of workers
+            rings = (struct spsc_ring*)aligned_alloc(CACHE_LINE, (size_t)num_threads * num_threads * sizeof(struct spsc_ring));
+            for (int i = 0; i < num_threads * num_threads; i++) {
+                atomic_init(&rings[i].head, 0);
+                atomic_init(&rings[i].tail, 0);
+                rings[i].cached_head = rings[i].cached_tail = 0;
+            }
+            shard_workers = (struct shard_worker*)aligned_alloc(CACHE_LINE, num_threads * sizeof(struct shard_worker));
+            for (int i = 0; i < num_threads; i++) {
+                atomic_init(&shard_workers[i].sent, 0);
+                atomic_init(&shard_workers[i].completed, 0);
+                atomic_init(&shard_workers[i].done, 0);
+            }
+            break;
+        case 5:
+            // No locks: the balances move to atomics
+            atomic_accounts = (atomic_int*)malloc(num_accounts * sizeof(atomic_int));
+            for (int i = 0; i < num_accounts; i++) {
+                atomic_init(&atomic_accounts[i], accounts[i]);
             }
             break;
         default:
@@ -391,6 +1098,13 @@ void init_locks() {
             pthread_mutex_init(&coarse_mutex, NULL);
             lock_type = 1;
     }
+
+    // Padded layout: move the initial balances next to their locks
+    if (balance_base != (char*)accounts) {
+        for (int i = 0; i < num_accounts; i++) {
+            BALANCE(i) = accounts[i];
+        }
+    }
 }
 
 // --- Destroy locks and free resources ---
@@ -400,26 +1114,53 @@ void destroy_locks() {
             pthread_mutex_destroy(&coarse_mutex);
             break;
         case 2:
-            if (fine_mutexes) {
-                for (int i = 0; i < num_accounts; i++) {
-                    pthread_mutex_destroy(&fine_mutexes[i]);
+            if (lock_base) {
+                for (int i = 0; i < num_locks; i++) {
+                    pthread_mutex_destroy(FINE_MUTEX(i));
                 }
-                free(fine_mutexes);
-                fine_mutexes = NULL;
+                free(lock_base);
+                lock_base = NULL;
             }
             break;
         case 3:
             pthread_rwlock_destroy(&coarse_rwlock);
             break;
         case 4:
-            if (fine_rwlocks) {
-                for (int i = 0; i < num_accounts; i++) {
-                    pthread_rwlock_destroy(&fine_rwlocks[i]);
+            if (lock_base) {
+                for (int i = 0; i < num_locks; i++) {
+                    pthread_rwlock_destroy(FINE_RWLOCK(i));
+                }
+                free(lock_base);
+                lock_base = NULL;
+            }
+            break;
+        case 5:
+            free(atomic_accounts);
+            atomic_accounts = NULL;
+            break;
+        case 6:
+            if (seq_stripes) {
+                for (int i = 0; i < num_stripes; i++) {
+                    pthread_mutex_destroy(&seq_stripes[i].writer);
                 }
-                free(fine_rwlocks);
-                fine_rwlocks = NULL;
+                free(seq_stripes);
+                seq_stripes = NULL;
             }
             break;
+        case 7: case 8: case 9: case 10: case 11: case 12:
+            free(spin_locks);
+            spin_locks = NULL;
+            break;
+        case 13:
+            free(fc_slots);
+            fc_slots = NULL;
+            break;
+        case 14:
+            free(rings);
+            free(shard_workers);
+            rings = NULL;
+            shard_workers = NULL;
+            break;
     }
 }
 
@@ -430,6 +1171,16 @@ const char* get_lock_name() {
         case 2: return "Fine-grained Mutex";
         case 3: return "Coarse-grained RWLock";
         case 4: return "Fine-grained RWLock";
+        case 5: return "Lock-free Atomic";
+        case 6: return "Seqlock (optimistic queries)";
+        case 7: return "Coarse-grained TTAS Spinlock";
+        case 8: return "Fine-grained TTAS Spinlock";
+        case 9: return "Coarse-grained Ticket Lock";
+        case 10: return "Fine-grained Ticket Lock";
+        case 11: return "Coarse-grained MCS Lock";
+        case 12: return "Fine-grained MCS Lock";
+        case 13: return "Flat Combining";
+        case 14: return "Sharded (message passing)";
         default: return "Unknown";
     }
 }
\ No newline at end of file
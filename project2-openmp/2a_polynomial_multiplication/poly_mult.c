@@ -3,65 +3,229 @@
 #include <sys/time.h>
 #include <time.h>
 #include <string.h>
+#include <limits.h>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
+#include "poly_dispatch.h"
+#include "poly_modular.h"
+#include "poly_io.h"
+#include "counter_rng.h"
+
 //DEBUG 1: lite debugging. 2: full debugging
 #define DEBUG 0 
 #define SEED 12
 #define WRITE_FILE 1
+#define STREAM_COEFF0 0 //Counter RNG stream of each generated buffer.
+#define STREAM_COEFF1 1
+#define STREAM_EVAL 2
+#define NTT_CHECK_SAMPLES 64 //Number of product coefficients spot-checked against a direct sum.
+
+// NTT-friendly primes p = c*2^k + 1 with primitive root 3. Their product (~7.9e16) bounds the
+// exact CRT result, which covers 999*999*(poly_order) for any order the transform supports.
+#define NTT_P1 167772161ULL //5*2^25 + 1
+#define NTT_P2 469762049ULL //7*2^26 + 1
+#define NTT_ROOT 3ULL
+#define NTT_MAX_LOG 25 //Transform length is limited by the smaller 2-adic order.
+
+#define COEFF_MAX 999 //Coefficients are drawn from [1, COEFF_MAX].
+#define KARATSUBA_CUTOFF 64 //Below these lengths the recursions use the 64-bit schoolbook kernel.
+#define TOOM3_CUTOFF 96
+#define TASK_DEPTH 6 //Recursion levels that still spawn OpenMP tasks.
+#define PROFILE_PATH "poly_mult_2a.profile"
+#define STREAM_BLOCK 4096 //Product coefficients handed to the writer at a time (-o, schoolbook).
+#define EVAL_P NTT_P2 //Evaluation field (NTT prime, so the subproduct tree can use ntt()).
+#define EVAL_LANES 8 //Points advanced together by one Horner step (one 512-bit vector of 64-bit lanes).
+#define EVAL_BLOCK 1024 //Points per OpenMP work item in the Horner evaluation.
+#define EVAL_TREE_LEAF 32 //Points per subproduct tree leaf (evaluated by Horner on the remainder).
+#define EVAL_NTT_FROM 64 //Shorter polynomial products and divisions in the tree are done directly.
+#define EVAL_CHECK_SAMPLES 64 //Horner values spot-checked against the scalar reference.
 
 // Functions
 void serial_poly_multiply();
-void omp_poly_multiply();
+void omp_poly_multiply(long long* result);
+long long* ntt_poly_multiply();
+int ntt_check_result();
+long long* omp_convolution_multiply();
+long long* omp_karatsuba_multiply();
+long long* omp_toom3_multiply();
+long long* dispatch_poly_multiply(int algorithm);
+long long* serial_mod_multiply();
+long long* omp_mod_multiply();
+int calibrate();
+int set_schedule(const char* arg);
+void run_evaluation(const long long* product, int len);
 double get_running_time(struct timeval time_final, struct timeval time_init);
 
 // Global variables
 int poly_order = 0;
 int thread_count = 0;
+uint64_t rng_seed; //Seed of the counter RNG that generates the inputs.
 int* poly_coeff0; 
 int* poly_coeff1; 
-int* serial_multiply_coeffs;
-int* omp_multiply_coeffs;
+long long coeff_bound = COEFF_MAX; //Largest |coefficient| of the operands (measured with -i).
+long long* serial_multiply_coeffs; //2*poly_order-1 coefficients, zero-initialized.
+long long* omp_multiply_coeffs;
+const char* schedule_name = "static"; //-s kind[,chunk]: schedule of the per-k loops (schedule(runtime)).
+int schedule_chunk = 0; //0: the OpenMP default chunk for the kind.
+long eval_points = 0; //-e points: evaluate the dispatched product at this many random points.
+int eval_tree = 0; //-T: also evaluate with the subproduct tree.
+long long* ntt_multiply_coeffs; //Exact product, 2*poly_order-1 coefficients.
+long long* dispatch_multiply_coeffs; //Product from the algorithm picked by the dispatcher.
+struct poly_mod modulus; //Optional prime for the Z_p product, modulus.p == 0 when not requested.
+uint64_t* mod_coeff0; //Residues in [0, p) of the Z_p operands.
+uint64_t* mod_coeff1;
+char* input_files = NULL; //-i a.bin,b.bin: operands mmap'd from polynomial files.
+char* output_file = NULL; //-o c.bin: stream the dispatched product to a polynomial file.
+char* generate_files = NULL; //-g a.bin,b.bin: write the random operands to polynomial files.
+struct poly_mapping coeff0_map;
+struct poly_mapping coeff1_map;
+struct poly_writer* stream_writer = NULL; //Set while the dispatched product is being streamed.
+
+// Split "a.bin,b.bin" in place; returns -1 without a comma.
+static int split_file_pair(char* arg, char** first, char** second)
+{
+	char* comma = strchr(arg, ',');
+	if (!comma || comma == arg || comma[1] == '\0')
+		return -1;
+	*comma = '\0';
+	*first = arg;
+	*second = comma + 1;
+	return 0;
+}
+
+// Coefficients in [1, COEFF_MAX] from the given stream, generated in parallel.
+static void random_coeffs(int* dst, int count, uint64_t stream)
+{
+	uint64_t key = crng_key(rng_seed, stream);
+#	pragma omp parallel for num_threads(thread_count)
+	for (int i = 0; i < count; ++i)
+		dst[i] = crng_int_in(key, i, 1, COEFF_MAX);
+}
 
 int main(int argc, char *argv[])
 {
-	if(argc != 3) {
+	// Flags may appear anywhere; the positional arguments are collected in args afterwards.
+	int opt;
+	while ((opt = getopt(argc, argv, "i:o:g:s:e:T")) != -1) {
+		if (opt == 'i')
+			input_files = optarg;
+		else if (opt == 'o')
+			output_file = optarg;
+		else if (opt == 'g')
+			generate_files = optarg;
+		else if (opt == 's' && set_schedule(optarg) == 0)
+			continue;
+		else if (opt == 'e' && (eval_points = atol(optarg)) > 0)
+			continue;
+		else if (opt == 'T')
+			eval_tree = 1;
+		else
+			argc = 0; //Print the usage below.
+	}
+	char** args = argv + optind;
+	int nargs = argc - optind;
+
+	if(nargs < 2 || nargs > 4) {
 		printf("\nError: Incorrect execution!");
-		printf("\nUsage: %s <polynomial_order> <thread_count>\n", argv[0]);
+		printf("\nUsage: %s <polynomial_order> <thread_count> [algorithm] [prime] [-s schedule] [-e points [-T]] [-i a.bin,b.bin] [-o c.bin] [-g a.bin,b.bin]\n", argv[0]);
 		printf("    polynomial_order: Order of the polynomial (positive integer)\n");
 		printf("    thread_count: Number of threads to use (positive integer)\n");
+		printf("    algorithm: auto (default, uses %s), schoolbook, karatsuba, toom3, transform,\n", PROFILE_PATH);
+		printf("               or calibrate to measure the crossovers up to polynomial_order and save them\n");
+		printf("    prime: also multiply random operands in Z_p (odd prime below 2^63, lazy Montgomery reduction)\n");
+		printf("    -s: schedule of the convolution loops: static (default), dynamic or guided, optionally ,chunk\n");
+		printf("    -e: evaluate the product at this many random points mod %llu (SIMD Horner), -T: also by subproduct tree\n", EVAL_P);
+		printf("    -i: mmap the operands from polynomial files (polynomial_order is taken from the files)\n");
+		printf("    -o: stream the dispatched product to a polynomial file while it is computed\n");
+		printf("    -g: write the random operands to polynomial files and exit\n");
 		printf("Example: %s 1000 4\n", argv[0]);
+		printf("         %s 20000 4 auto 998244353\n", argv[0]);
 		return 1;
 	}
 
 	// Check the arguments are valid
-	if (atoi(argv[1]) <=0) {
+	if (atoi(args[0]) <=0) {
 		printf("Error: polynomial_order must be a positive integer.\n");
 		return 1;
 	} 
-	if (atoi(argv[3]) <=0) {
+	if (atoi(args[1]) <=0) {
 		printf("Error: thread_count must be positive integer.\n");
 		return 1;
 	}
 	
 	// Parse arguments
-	poly_order = strtol(argv[1], NULL, 10);
-	thread_count = strtol(argv[2], NULL, 10);
-	serial_multiply_coeffs = (int*) malloc(poly_order*sizeof(int));
-	omp_multiply_coeffs = (int*) malloc(poly_order*sizeof(int));
+	poly_order = strtol(args[0], NULL, 10);
+	thread_count = strtol(args[1], NULL, 10);
+	int algorithm = -1; //-1: auto
+	if (nargs >= 3 && strcmp(args[2], "calibrate") == 0)
+		return calibrate();
+	if (nargs >= 3 && strcmp(args[2], "auto") != 0) {
+		algorithm = poly_alg_from_name(args[2]);
+		if (algorithm < 0) {
+			printf("Error: unknown algorithm %s.\n", args[2]);
+			return 1;
+		}
+	}
+	if (nargs == 4 && poly_mod_init(&modulus, strtoull(args[3], NULL, 10)) != 0) {
+		printf("Error: %s is not an odd prime below 2^63.\n", args[3]);
+		return 1;
+	}
+	if (input_files && generate_files) {
+		printf("Error: -i and -g cannot be combined.\n");
+		return 1;
+	}
+	if (input_files) {
+		// The operands are used straight from the mapping, no parse or copy.
+		char* path0;
+		char* path1;
+		uint64_t count0, count1;
+		if (split_file_pair(input_files, &path0, &path1) != 0) {
+			printf("Error: -i expects two files: a.bin,b.bin\n");
+			return 1;
+		}
+		poly_coeff0 = (int*) poly_file_map(path0, sizeof(int), &count0, &coeff0_map);
+		poly_coeff1 = poly_coeff0 ? (int*) poly_file_map(path1, sizeof(int), &count1, &coeff1_map) : NULL;
+		if (!poly_coeff0 || !poly_coeff1)
+			return 1;
+		if (count0 != count1 || count0 > INT_MAX / 2) {
+			printf("Error: operand files must have the same number of coefficients (at most %d).\n", INT_MAX / 2);
+			return 1;
+		}
+		poly_order = (int) count0;
+		long long max0 = poly_max_abs(poly_coeff0, poly_order);
+		long long max1 = poly_max_abs(poly_coeff1, poly_order);
+		coeff_bound = (max0 > max1) ? max0 : max1;
+	}
+	//Every product below is exact 64-bit, so operands (e.g. from -i) too large for it are rejected.
+	const char* limit = poly_operand_limit(algorithm < 0 ? POLY_ALG_SCHOOLBOOK : algorithm, coeff_bound, poly_order
+			, KARATSUBA_CUTOFF, LLONG_MAX, NTT_P1 * NTT_P2);
+	if (limit) {
+		printf("Error: operands with coefficients up to %lld in magnitude are too large for %s: %s.\n"
+				, coeff_bound, poly_alg_names[algorithm < 0 ? POLY_ALG_SCHOOLBOOK : algorithm], limit);
+		return 1;
+	}
+	//The NTT reference of Step 4 only covers products within the range of its primes.
+	int ntt_fits = poly_operand_limit(POLY_ALG_TRANSFORM, coeff_bound, poly_order, KARATSUBA_CUTOFF, LLONG_MAX, NTT_P1 * NTT_P2) == NULL;
+	serial_multiply_coeffs = (long long*) calloc(2 * poly_order - 1, sizeof(long long));
+	omp_multiply_coeffs = (long long*) calloc(2 * poly_order - 1, sizeof(long long));
 
 	// Print the Setup 
 	printf("\n---- Polynomial Multiplication (OpenMP) ----\n");
 	printf("Polynomial order: %d\n", poly_order);
-	printf("Number of threads: %d\n\n", thread_count);
+	printf("Number of threads: %d\n", thread_count);
+	if (schedule_chunk > 0)
+		printf("Convolution schedule: %s,%d\n\n", schedule_name, schedule_chunk);
+	else
+		printf("Convolution schedule: %s\n\n", schedule_name);
 	
 	// Initialize random seed
 	if (DEBUG)
-		srand(SEED); // For reproducibility
+		rng_seed = SEED; // For reproducibility
 	else
-		srand(time(NULL));
+		rng_seed = time(NULL);
+	srand(rng_seed); //rand() only picks the coefficients that are spot-checked.
 	// Time arguments
 	struct timeval time_init;
 	struct timeval time_final;
@@ -69,7 +233,7 @@ int main(int argc, char *argv[])
 
 	// File arguments (if necessary)
 	char file_name[100];
-	sprintf(file_name, "%s_%sthr_%sorder.csv", argv[0], argv[2], argv[1]); 
+	sprintf(file_name, "%s_%dthr_%dorder.csv", argv[0], thread_count, poly_order); 
 	FILE* results_file = fopen(file_name, "a");
 	if (!WRITE_FILE) { //Don't create file if not needed.
 		remove(file_name);
@@ -77,25 +241,23 @@ int main(int argc, char *argv[])
 	}
 	//If file is empty (just created), fill first line with column names.
 	else if (ftell(results_file) == 0) {
-		fprintf(results_file, "Serial results (sec);Parallel results (sec) (%d threads)\n", thread_count);
+		fprintf(results_file, "Serial results (sec);Parallel results (sec);NTT results (sec);Dispatched results (sec) (%d threads)\n", thread_count);
 	}
 
 
-	// Step 1: Randomly generate polynomial coefficients (serially).
+	// Step 1: Randomly generate polynomial coefficients (in parallel, same values for any thread count). Skipped when they are mapped (-i).
 	gettimeofday(&time_init, NULL);
-	srand(time(0));
-	poly_coeff0 = (int*) malloc(poly_order*sizeof(int));
-	poly_coeff1 = (int*) malloc(poly_order*sizeof(int));
-	for (int i = 0; i < poly_order; ++i)
-	{
-
-		do {
-			poly_coeff0[i] = rand() % 1000;
-			poly_coeff1[i] = rand() % 1000;
-		} while (poly_coeff0[i] == 0 || poly_coeff1[i] == 0);
-		if (DEBUG == 2) {
-			printf("poly_coeff0[%d] = %d\n", i, poly_coeff0[i]);
-			printf("poly_coeff1[%d] = %d\n", i, poly_coeff1[i]);
+	if (!input_files) {
+		poly_coeff0 = (int*) malloc(poly_order*sizeof(int));
+		poly_coeff1 = (int*) malloc(poly_order*sizeof(int));
+		random_coeffs(poly_coeff0, poly_order, STREAM_COEFF0);
+		random_coeffs(poly_coeff1, poly_order, STREAM_COEFF1);
+		for (int i = 0; i < poly_order; ++i)
+		{
+			if (DEBUG == 2) {
+				printf("poly_coeff0[%d] = %d\n", i, poly_coeff0[i]);
+				printf("poly_coeff1[%d] = %d\n", i, poly_coeff1[i]);
+			}
 		}
 	}
 	gettimeofday(&time_final, NULL);
@@ -103,6 +265,25 @@ int main(int argc, char *argv[])
 	running_time = get_running_time(time_final, time_init);
 	printf("Polynomial coefficient generation of order %d polynomials took %lf seconds.\n",
 			poly_order, running_time);
+	if (generate_files) {
+		char* path0;
+		char* path1;
+		int status = 1;
+		if (split_file_pair(generate_files, &path0, &path1) != 0)
+			printf("Error: -g expects two files: a.bin,b.bin\n");
+		else if (poly_file_write(path0, poly_coeff0, sizeof(int), poly_order) == 0
+				&& poly_file_write(path1, poly_coeff1, sizeof(int), poly_order) == 0) {
+			printf("Wrote the operands to %s and %s.\n", path0, path1);
+			status = 0;
+		}
+		if (WRITE_FILE)
+			fclose(results_file);
+		free(poly_coeff0);
+		free(poly_coeff1);
+		free(serial_multiply_coeffs);
+		free(omp_multiply_coeffs);
+		return status;
+	}
 
 
 	//Step 2: Serial polynomial multiplication.
@@ -119,27 +300,135 @@ int main(int argc, char *argv[])
 		
 	//Step 3: Parallel polynomial multiplication.
 	gettimeofday(&time_init, NULL);
-	omp_poly_multiply();
+	omp_poly_multiply(omp_multiply_coeffs);
 	gettimeofday(&time_final, NULL);
 	//Calculate running time for parallel execution.
 	running_time = get_running_time(time_final, time_init);
 	printf("Parallel polynomial multiplication of order %d polynomials with %d threads took %lf seconds.\n"
 			, poly_order,thread_count, running_time);
 	if (WRITE_FILE) 
+		fprintf(results_file, "%lf;", running_time);
+
+
+	//Step 4: NTT polynomial multiplication (exact product via CRT over two primes).
+	if (!ntt_fits) {
+		printf("NTT polynomial multiplication skipped: coefficients up to %lld exceed the range of the NTT primes.\n", coeff_bound);
+		if (WRITE_FILE)
+			fprintf(results_file, ";");
+	}
+	else {
+		gettimeofday(&time_init, NULL);
+		ntt_multiply_coeffs = ntt_poly_multiply();
+		gettimeofday(&time_final, NULL);
+		//Calculate running time for NTT execution.
+		running_time = get_running_time(time_final, time_init);
+		printf("NTT polynomial multiplication of order %d polynomials with %d threads took %lf seconds.\n"
+				, poly_order, thread_count, running_time);
+		if (WRITE_FILE)
+			fprintf(results_file, "%lf;", running_time);
+		if (ntt_check_result() != 0)
+			printf("WARNING: NTT product does not match the direct convolution!\n");
+	}
+
+
+	//Step 5: Dispatched polynomial multiplication (algorithm from the calibrated profile).
+	if (algorithm < 0) {
+		int from_profile;
+		algorithm = poly_dispatch(PROFILE_PATH, thread_count, poly_coeff_bits(coeff_bound), poly_order - 1, &from_profile);
+		printf("Dispatcher picked %s (%s).\n", poly_alg_names[algorithm], from_profile ? PROFILE_PATH : "no profile, defaults");
+		if (poly_operand_limit(algorithm, coeff_bound, poly_order, KARATSUBA_CUTOFF, LLONG_MAX, NTT_P1 * NTT_P2)) {
+			algorithm = POLY_ALG_SCHOOLBOOK; //Too large for the pick, the schoolbook product only needs 64-bit sums.
+			printf("Dispatcher: coefficients up to %lld, falling back to %s.\n", coeff_bound, poly_alg_names[algorithm]);
+		}
+	}
+	// With -o the schoolbook candidate streams finished blocks while it computes; the other
+	// algorithms only have the product at the end and hand it over in one piece.
+	struct poly_writer writer;
+	if (output_file) {
+		if (poly_writer_open(&writer, output_file, 2 * poly_order - 1) != 0)
+			return 1;
+		stream_writer = &writer;
+	}
+	gettimeofday(&time_init, NULL);
+	dispatch_multiply_coeffs = dispatch_poly_multiply(algorithm);
+	gettimeofday(&time_final, NULL);
+	running_time = get_running_time(time_final, time_init);
+	printf("Dispatched (%s) polynomial multiplication of order %d polynomials with %d threads took %lf seconds.\n"
+			, poly_alg_names[algorithm], poly_order, thread_count, running_time);
+	if (WRITE_FILE)
 		fprintf(results_file, "%lf\n", running_time);
+	if (output_file) {
+		if (algorithm != POLY_ALG_SCHOOLBOOK)
+			poly_writer_submit(&writer, dispatch_multiply_coeffs, 0, 2 * poly_order - 1);
+		gettimeofday(&time_init, NULL);
+		int write_status = poly_writer_close(&writer);
+		gettimeofday(&time_final, NULL);
+		stream_writer = NULL;
+		printf("Product written to %s, %lf seconds of writing left after the multiplication%s.\n"
+				, output_file, get_running_time(time_final, time_init), write_status == 0 ? "" : " (WRITE FAILED)");
+	}
+	//Checked against the direct (serial) convolution, not the NTT: the NTT may be the dispatched algorithm.
+	for (int i = 0; i < 2 * poly_order - 1; ++i) {
+		if (dispatch_multiply_coeffs[i] != serial_multiply_coeffs[i]) {
+			printf("WARNING: dispatch_multiply_coeffs[%d] = %lld and serial_multiply_coeffs[%d] = %lld are different!\n"
+					, i, dispatch_multiply_coeffs[i], i, serial_multiply_coeffs[i]);
+			break;
+		}
+	}
 
 	if (DEBUG == 2) {
+		for (int i = 0; i < 2 * poly_order - 1; ++i) {
+			printf("serial_multiply_coeffs[%d] = %lld\n", i, serial_multiply_coeffs[i]);
+			printf("omp_multiply_coeffs[%d] = %lld\n", i, omp_multiply_coeffs[i]);
+		}
+	}
+
+	//Step 6 (optional): product in Z_p, lazy Montgomery reduction against a per-multiply reference.
+	if (modulus.p) {
+		mod_coeff0 = (uint64_t*) malloc(poly_order * sizeof(uint64_t));
+		mod_coeff1 = (uint64_t*) malloc(poly_order * sizeof(uint64_t));
+		uint64_t key0 = crng_key(rng_seed, STREAM_COEFF0);
+		uint64_t key1 = crng_key(rng_seed, STREAM_COEFF1);
+#		pragma omp parallel for num_threads(thread_count)
 		for (int i = 0; i < poly_order; ++i) {
-			printf("serial_multiply_coeffs[%d] = %d\n", i, serial_multiply_coeffs[i]);
-			printf("omp_multiply_coeffs[%d] = %d\n", i, omp_multiply_coeffs[i]);
+			mod_coeff0[i] = crng_below(key0, i, modulus.p);
+			mod_coeff1[i] = crng_below(key1, i, modulus.p);
+		}
+		gettimeofday(&time_init, NULL);
+		long long* mod_reference = serial_mod_multiply();
+		gettimeofday(&time_final, NULL);
+		running_time = get_running_time(time_final, time_init);
+		printf("Serial Z_p multiplication (mod %llu, reduce every product) took %lf seconds.\n"
+				, (unsigned long long) modulus.p, running_time);
+		gettimeofday(&time_init, NULL);
+		long long* mod_result = omp_mod_multiply();
+		gettimeofday(&time_final, NULL);
+		running_time = get_running_time(time_final, time_init);
+		printf("Parallel Z_p multiplication (reduce every %ld products) with %d threads took %lf seconds.\n"
+				, modulus.lazy, thread_count, running_time);
+		for (int i = 0; i < 2 * poly_order - 1; ++i) {
+			if (mod_result[i] != mod_reference[i]) {
+				printf("WARNING: mod_result[%d] = %lld and mod_reference[%d] = %lld are different!\n"
+						, i, mod_result[i], i, mod_reference[i]);
+				break;
+			}
 		}
+		free(mod_reference);
+		free(mod_result);
+		free(mod_coeff0);
+		free(mod_coeff1);
 	}
 
+	//Step 7 (optional): evaluate the product at many points.
+	if (eval_points > 0)
+		run_evaluation(dispatch_multiply_coeffs, 2 * poly_order - 1);
+
 	//Check that results are the same.
-	for (int i = 0; i < poly_order; ++i) {
+	for (int i = 0; i < 2 * poly_order - 1; ++i) {
 		if (serial_multiply_coeffs[i] != omp_multiply_coeffs[i]) {
-			printf("WARNING: serial_multiply_coeffs[%d] = %d and omp_multiply_coeffs[%d] = %d are different!\n"
+			printf("WARNING: serial_multiply_coeffs[%d] = %lld and omp_multiply_coeffs[%d] = %lld are different!\n"
 					, i, serial_multiply_coeffs[i], i, omp_multiply_coeffs[i]);
+			break;
 		}
 	}
 
@@ -147,14 +436,47 @@ int main(int argc, char *argv[])
 		fclose(results_file);
 
 	//Free memory.
-	free(poly_coeff0);
-	free(poly_coeff1);
+	if (input_files) {
+		poly_file_unmap(&coeff0_map);
+		poly_file_unmap(&coeff1_map);
+	}
+	else {
+		free(poly_coeff0);
+		free(poly_coeff1);
+	}
 	free(serial_multiply_coeffs);
 	free(omp_multiply_coeffs);
+	free(ntt_multiply_coeffs);
+	free(dispatch_multiply_coeffs);
 
 	return 0;
 }
 
+// Parse -s kind[,chunk] and make it the schedule of the schedule(runtime) loops. Returns -1 if invalid.
+int set_schedule(const char* arg)
+{
+	char kind[16];
+	int chunk = 0;
+	if (sscanf(arg, "%15[a-z],%d", kind, &chunk) < 1 || chunk < 0)
+		return -1;
+#ifdef _OPENMP
+	omp_sched_t sched;
+	if (strcmp(kind, "static") == 0)
+		sched = omp_sched_static;
+	else if (strcmp(kind, "dynamic") == 0)
+		sched = omp_sched_dynamic;
+	else if (strcmp(kind, "guided") == 0)
+		sched = omp_sched_guided;
+	else
+		return -1;
+	omp_set_schedule(sched, chunk);
+#endif
+	schedule_name = (strcmp(kind, "static") == 0) ? "static" : (strcmp(kind, "dynamic") == 0) ? "dynamic" : "guided";
+	schedule_chunk = chunk;
+	return 0;
+}
+
+// Reference product: every a_i*b_j added into the zeroed serial_multiply_coeffs[i+j].
 void serial_poly_multiply()
 {
 	if (DEBUG >= 1) {
@@ -163,28 +485,827 @@ void serial_poly_multiply()
 	}
 	for (int i = 0; i < poly_order; ++i) {
 		for (int j = 0; j < poly_order; ++j) {
-			serial_multiply_coeffs[i] += poly_coeff0[i]*poly_coeff1[j];
+			serial_multiply_coeffs[i + j] += (long long) poly_coeff0[i] * poly_coeff1[j];
 		}
 	}
 	return;
 }
 
-void omp_poly_multiply()
+// Convolution partitioned over the 2*poly_order-1 output coefficients. Each iteration sums
+// its own coefficient in a private accumulator and stores it once, so threads never write
+// to the same location and never read each other's output. The schedule comes from -s.
+void omp_poly_multiply(long long* result)
 {
 	if (DEBUG >= 1) {
 		printf("In omp_poly_multiply.\n");
 		printf("\npoly_order = %d\n", poly_order);
 	}
+	int result_len = 2 * poly_order - 1;
+	#pragma omp parallel for num_threads(thread_count) schedule(runtime)
+	for (int k = 0; k < result_len; ++k) {
+		int i_min = (k - poly_order + 1 > 0) ? k - poly_order + 1 : 0;
+		int i_max = (k < poly_order - 1) ? k : poly_order - 1;
+		long long sum = 0;
+		for (int i = i_min; i <= i_max; ++i)
+			sum += (long long) poly_coeff0[i] * poly_coeff1[k - i];
+		result[k] = sum;
+		if (DEBUG == 2) {
+			printf("result[%d] = %lld\n", k, result[k]);
+		}
+	}
+	return;
+}
+
+// ---- Number-theoretic transform ----
+static unsigned long long mod_pow(unsigned long long base, unsigned long long exp, unsigned long long mod)
+{
+	unsigned long long result = 1;
+	base %= mod;
+	while (exp > 0) {
+		if (exp & 1)
+			result = result * base % mod;
+		base = base * base % mod;
+		exp >>= 1;
+	}
+	return result;
+}
+
+// In-place iterative radix-2 NTT of length len (power of two) modulo mod.
+// invert != 0 computes the inverse transform, including the 1/len scaling.
+static void ntt(unsigned long long* a, int len, unsigned long long mod, int invert)
+{
+	int log_len = 0;
+	while ((1 << log_len) < len)
+		++log_len;
+
+	//Bit-reversal permutation: every index swaps with its mirror exactly once.
+	#pragma omp parallel for num_threads(thread_count)
+	for (int i = 0; i < len; ++i) {
+		int j = 0;
+		for (int b = 0; b < log_len; ++b)
+			j |= ((i >> b) & 1) << (log_len - 1 - b);
+		if (i < j) {
+			unsigned long long tmp = a[i];
+			a[i] = a[j];
+			a[j] = tmp;
+		}
+	}
+
+	//Twiddle table: roots[half + k] = w_(2*half)^k for every stage.
+	unsigned long long* roots = (unsigned long long*) malloc(len * sizeof(unsigned long long));
+	for (int half = 1; half < len; half <<= 1) {
+		unsigned long long w = mod_pow(NTT_ROOT, (mod - 1) / (2 * half), mod);
+		if (invert)
+			w = mod_pow(w, mod - 2, mod);
+		roots[half] = 1;
+		for (int k = 1; k < half; ++k)
+			roots[half + k] = roots[half + k - 1] * w % mod;
+	}
+
+	//Butterfly stages: the len/2 butterflies of a stage are independent.
+	for (int half = 1; half < len; half <<= 1) {
+		#pragma omp parallel for num_threads(thread_count)
+		for (int j = 0; j < len / 2; ++j) {
+			int k = j & (half - 1);
+			int i = ((j - k) << 1) + k;
+			unsigned long long u = a[i];
+			unsigned long long v = a[i + half] * roots[half + k] % mod;
+			a[i] = (u + v < mod) ? u + v : u + v - mod;
+			a[i + half] = (u >= v) ? u - v : u + mod - v;
+		}
+	}
+	free(roots);
+
+	if (invert) {
+		unsigned long long len_inv = mod_pow(len, mod - 2, mod);
+		#pragma omp parallel for num_threads(thread_count)
+		for (int i = 0; i < len; ++i)
+			a[i] = a[i] * len_inv % mod;
+	}
+}
+
+// Cyclic product of the two input polynomials modulo mod, zero-padded to len.
+static unsigned long long* ntt_product_mod(int len, unsigned long long mod)
+{
+	unsigned long long* fa = (unsigned long long*) malloc(len * sizeof(unsigned long long));
+	unsigned long long* fb = (unsigned long long*) malloc(len * sizeof(unsigned long long));
+
+	//Map the (possibly negative, e.g. from -i files) coefficients into [0, mod).
+	long long m = (long long) mod;
+	#pragma omp parallel for num_threads(thread_count)
+	for (int i = 0; i < len; ++i) {
+		fa[i] = (i < poly_order) ? (unsigned long long) ((poly_coeff0[i] % m + m) % m) : 0;
+		fb[i] = (i < poly_order) ? (unsigned long long) ((poly_coeff1[i] % m + m) % m) : 0;
+	}
+
+	ntt(fa, len, mod, 0);
+	ntt(fb, len, mod, 0);
+	//Pointwise products.
 	#pragma omp parallel for num_threads(thread_count)
+	for (int i = 0; i < len; ++i)
+		fa[i] = fa[i] * fb[i] % mod;
+	ntt(fa, len, mod, 1);
+
+	free(fb);
+	return fa;
+}
+
+long long* ntt_poly_multiply()
+{
+	if (DEBUG >= 1) {
+		printf("In ntt_poly_multiply.\n");
+		printf("\npoly_order = %d\n", poly_order);
+	}
+	int result_len = 2 * poly_order - 1;
+	int len = 1;
+	while (len < result_len)
+		len <<= 1;
+	if (len > (1 << NTT_MAX_LOG)) {
+		printf("Error: polynomial order %d is too large for the NTT primes.\n", poly_order);
+		exit(1);
+	}
+
+	unsigned long long* r1 = ntt_product_mod(len, NTT_P1);
+	unsigned long long* r2 = ntt_product_mod(len, NTT_P2);
+
+	//CRT: x = r1 + P1 * ((r2 - r1) * P1^-1 mod P2) in [0, P1*P2), and values above P1*P2/2 are
+	//the negative coefficients (exact since |true value| is below P1*P2/2).
+	unsigned long long p1_inv = mod_pow(NTT_P1, NTT_P2 - 2, NTT_P2);
+	unsigned long long modulus = NTT_P1 * NTT_P2;
+	long long* result = (long long*) malloc(result_len * sizeof(long long));
+	#pragma omp parallel for num_threads(thread_count)
+	for (int i = 0; i < result_len; ++i) {
+		unsigned long long diff = (r2[i] + NTT_P2 - r1[i] % NTT_P2) % NTT_P2;
+		unsigned long long t = diff * p1_inv % NTT_P2;
+		unsigned long long x = r1[i] + NTT_P1 * t;
+		result[i] = (x > modulus / 2) ? (long long) x - (long long) modulus : (long long) x;
+	}
+
+	free(r1);
+	free(r2);
+	return result;
+}
+
+// Spot-check the NTT product against direct sums for the two end coefficients and a sample in
+// between (a full O(n^2) check is what the NTT path is meant to avoid). Returns the mismatches.
+int ntt_check_result()
+{
+	int result_len = 2 * poly_order - 1;
+	int mismatches = 0;
+	for (int s = 0; s < NTT_CHECK_SAMPLES + 2; ++s) {
+		int k;
+		if (s == 0)
+			k = 0;
+		else if (s == 1)
+			k = result_len - 1;
+		else
+			k = rand() % result_len;
+		int i_min = (k - poly_order + 1 > 0) ? k - poly_order + 1 : 0;
+		int i_max = (k < poly_order - 1) ? k : poly_order - 1;
+		long long sum = 0;
+		for (int i = i_min; i <= i_max; ++i)
+			sum += (long long) poly_coeff0[i] * poly_coeff1[k - i];
+		if (sum != ntt_multiply_coeffs[k]) {
+			if (DEBUG >= 1)
+				printf("ntt_multiply_coeffs[%d] = %lld, expected %lld\n", k, ntt_multiply_coeffs[k], sum);
+			++mismatches;
+		}
+	}
+	return mismatches;
+}
+
+// ---- Multipoint evaluation ----
+// The product is evaluated in Z_p for p = EVAL_P (an NTT prime, so values are exact and the
+// subproduct tree can multiply with ntt()). Coefficients and points are residues < 2^29, so
+// a product fits in 64 bits and is reduced with a double-precision Barrett estimate, which
+// unlike % vectorizes.
+
+static inline unsigned long long eval_mulmod(unsigned long long a, unsigned long long b)
+{
+	unsigned long long prod = a * b;
+	long long r = (long long) (prod - (unsigned long long) ((double) prod * (1.0 / EVAL_P)) * EVAL_P);
+	r += (r < 0) ? (long long) EVAL_P : 0; //The estimate is off by at most one.
+	r -= (r >= (long long) EVAL_P) ? (long long) EVAL_P : 0;
+	return (unsigned long long) r;
+}
+
+// Reference: scalar Horner with % for one point.
+static unsigned long long eval_horner_scalar(const unsigned long long* f, int len, unsigned long long x)
+{
+	unsigned long long acc = 0;
+	for (int c = len - 1; c >= 0; --c)
+		acc = (acc * x + f[c]) % EVAL_P;
+	return acc;
+}
+
+// Horner over EVAL_LANES points at once: the lanes share every coefficient load and their
+// multiply-reduce chains are independent, so the lane loop maps onto one SIMD register.
+static void eval_horner_lanes(const unsigned long long* f, int len, const unsigned long long* x, unsigned long long* y, int count)
+{
+	unsigned long long xs[EVAL_LANES];
+	unsigned long long acc[EVAL_LANES];
+	for (int l = 0; l < EVAL_LANES; ++l) {
+		xs[l] = (l < count) ? x[l] : 0;
+		acc[l] = 0;
+	}
+	for (int c = len - 1; c >= 0; --c) {
+		unsigned long long coeff = f[c];
+		#pragma omp simd
+		for (int l = 0; l < EVAL_LANES; ++l) {
+			unsigned long long v = eval_mulmod(acc[l], xs[l]) + coeff;
+			acc[l] = (v >= EVAL_P) ? v - EVAL_P : v;
+		}
+	}
+	for (int l = 0; l < count; ++l)
+		y[l] = acc[l];
+}
+
+// f (len coefficients) at every point, OpenMP over blocks of EVAL_BLOCK points.
+void eval_horner(const unsigned long long* f, int len, const unsigned long long* x, unsigned long long* y, long points)
+{
+	long blocks = (points + EVAL_BLOCK - 1) / EVAL_BLOCK;
+	#pragma omp parallel for num_threads(thread_count) schedule(dynamic, 1)
+	for (long b = 0; b < blocks; ++b) {
+		long end = (b + 1) * EVAL_BLOCK < points ? (b + 1) * EVAL_BLOCK : points;
+		for (long i = b * EVAL_BLOCK; i < end; i += EVAL_LANES) {
+			int count = (end - i < EVAL_LANES) ? (int) (end - i) : EVAL_LANES;
+			eval_horner_lanes(f, len, x + i, y + i, count);
+		}
+	}
+}
+
+// Subproduct tree. Points are taken in chunks of about deg(f) points; the leaves of a chunk's
+// tree are the products of EVAL_TREE_LEAF linear factors (X - x_i), and every inner node is
+// the product of its two children. f is reduced modulo the root and the remainders are pushed
+// down to the leaves, where the remaining polynomial (degree < EVAL_TREE_LEAF) is evaluated by
+// Horner. With ntt() products and Newton-inverse remainders a chunk costs O(M(n) log n)
+// instead of the O(n^2) of Horner.
+struct eval_poly {
+	unsigned long long* c;
+	int len;
+};
+
+// r = a*b (la + lb - 1 coefficients), schoolbook for short operands.
+static void eval_poly_mul(const unsigned long long* a, int la, const unsigned long long* b, int lb, unsigned long long* r)
+{
+	int rl = la + lb - 1;
+	if (la < EVAL_NTT_FROM || lb < EVAL_NTT_FROM) {
+		memset(r, 0, rl * sizeof(unsigned long long));
+		for (int i = 0; i < la; ++i)
+			for (int j = 0; j < lb; ++j)
+				r[i + j] = (r[i + j] + a[i] * b[j]) % EVAL_P;
+		return;
+	}
+	int len = 1;
+	while (len < rl)
+		len <<= 1;
+	unsigned long long* fa = (unsigned long long*) calloc(len, sizeof(unsigned long long));
+	unsigned long long* fb = (unsigned long long*) calloc(len, sizeof(unsigned long long));
+	memcpy(fa, a, la * sizeof(unsigned long long));
+	memcpy(fb, b, lb * sizeof(unsigned long long));
+	ntt(fa, len, EVAL_P, 0);
+	ntt(fb, len, EVAL_P, 0);
+	for (int i = 0; i < len; ++i)
+		fa[i] = fa[i] * fb[i] % EVAL_P;
+	ntt(fa, len, EVAL_P, 1);
+	memcpy(r, fa, rl * sizeof(unsigned long long));
+	free(fa);
+	free(fb);
+}
+
+// out = a^-1 mod x^k (a[0] != 0) by Newton iteration g <- g (2 - a g).
+static void eval_series_inverse(const unsigned long long* a, int la, int k, unsigned long long* out)
+{
+	unsigned long long* t = (unsigned long long*) malloc(2 * k * sizeof(unsigned long long));
+	unsigned long long* u = (unsigned long long*) malloc(2 * k * sizeof(unsigned long long));
+	out[0] = mod_pow(a[0], EVAL_P - 2, EVAL_P);
+	for (int cur = 1; cur < k; ) {
+		int next = (2 * cur < k) ? 2 * cur : k;
+		int use = (la < next) ? la : next;
+		eval_poly_mul(a, use, out, cur, t); //a g, first next terms used
+		for (int i = 0; i < next; ++i)
+			t[i] = (i < use + cur - 1) ? (EVAL_P - t[i]) % EVAL_P : 0;
+		t[0] = (t[0] + 2) % EVAL_P;
+		eval_poly_mul(out, cur, t, next, u);
+		memcpy(out, u, next * sizeof(unsigned long long));
+		cur = next;
+	}
+	free(t);
+	free(u);
+}
+
+// r = f mod g for monic g, lg - 1 coefficients.
+static void eval_poly_rem(const unsigned long long* f, int lf, const unsigned long long* g, int lg, unsigned long long* r)
+{
+	if (lf < lg) {
+		memcpy(r, f, lf * sizeof(unsigned long long));
+		memset(r + lf, 0, (lg - 1 - lf) * sizeof(unsigned long long));
+		return;
+	}
+	int m = lf - lg + 1; //Quotient length
+	if (m < EVAL_NTT_FROM || lg < EVAL_NTT_FROM) {
+		//Long division, top coefficient first.
+		unsigned long long* t = (unsigned long long*) malloc(lf * sizeof(unsigned long long));
+		memcpy(t, f, lf * sizeof(unsigned long long));
+		for (int i = lf - 1; i >= lg - 1; --i) {
+			unsigned long long q = t[i];
+			if (q == 0)
+				continue;
+			for (int j = 0; j < lg; ++j)
+				t[i - (lg - 1) + j] = (t[i - (lg - 1) + j] + (EVAL_P - q) * g[j]) % EVAL_P;
+		}
+		memcpy(r, t, (lg - 1) * sizeof(unsigned long long));
+		free(t);
+		return;
+	}
+	//rev(q) = rev(f) / rev(g) mod x^m, then r = f - q g.
+	int lgr = (lg < m) ? lg : m;
+	unsigned long long* frev = (unsigned long long*) malloc(m * sizeof(unsigned long long));
+	unsigned long long* grev = (unsigned long long*) malloc(lgr * sizeof(unsigned long long));
+	unsigned long long* ginv = (unsigned long long*) malloc(m * sizeof(unsigned long long));
+	unsigned long long* prod = (unsigned long long*) malloc((lf + m) * sizeof(unsigned long long));
+	for (int i = 0; i < m; ++i)
+		frev[i] = f[lf - 1 - i];
+	for (int i = 0; i < lgr; ++i)
+		grev[i] = g[lg - 1 - i];
+	eval_series_inverse(grev, lgr, m, ginv);
+	eval_poly_mul(frev, m, ginv, m, prod);
+	unsigned long long* q = frev; //reuse
+	for (int i = 0; i < m; ++i)
+		q[i] = prod[m - 1 - i];
+	eval_poly_mul(q, m, g, lg, prod);
+	for (int i = 0; i < lg - 1; ++i)
+		r[i] = (f[i] + EVAL_P - prod[i]) % EVAL_P;
+	free(frev);
+	free(grev);
+	free(ginv);
+	free(prod);
+}
+
+// Evaluate f at count points with one subproduct tree. parallel_nodes spreads the nodes of
+// each level over the threads (used when there are fewer chunks than threads).
+static void eval_tree_chunk(const unsigned long long* f, int lf, const unsigned long long* x, unsigned long long* y, int count, int parallel_nodes)
+{
+	int leaves = (count + EVAL_TREE_LEAF - 1) / EVAL_TREE_LEAF;
+	int levels = 1;
+	while ((1 << (levels - 1)) < leaves)
+		++levels;
+	struct eval_poly** tree = (struct eval_poly**) malloc(levels * sizeof(struct eval_poly*));
+	int* width = (int*) malloc(levels * sizeof(int));
+
+	//Leaves: prod (X - x_i) over a group of points, built one factor at a time.
+	width[0] = leaves;
+	tree[0] = (struct eval_poly*) malloc(leaves * sizeof(struct eval_poly));
+	#pragma omp parallel for num_threads(thread_count) schedule(dynamic, 1) if(parallel_nodes)
+	for (int j = 0; j < leaves; ++j) {
+		int start = j * EVAL_TREE_LEAF;
+		int n = (count - start < EVAL_TREE_LEAF) ? count - start : EVAL_TREE_LEAF;
+		unsigned long long* c = (unsigned long long*) calloc(n + 1, sizeof(unsigned long long));
+		c[0] = 1;
+		for (int i = 0; i < n; ++i) {
+			unsigned long long neg = (EVAL_P - x[start + i]) % EVAL_P;
+			for (int d = i + 1; d > 0; --d)
+				c[d] = (c[d - 1] + c[d] * neg) % EVAL_P;
+			c[0] = c[0] * neg % EVAL_P;
+		}
+		tree[0][j].c = c;
+		tree[0][j].len = n + 1;
+	}
+	//Inner nodes: product of the two children (a lone child is copied up).
+	for (int h = 1; h < levels; ++h) {
+		width[h] = (width[h - 1] + 1) / 2;
+		tree[h] = (struct eval_poly*) malloc(width[h] * sizeof(struct eval_poly));
+		#pragma omp parallel for num_threads(thread_count) schedule(dynamic, 1) if(parallel_nodes)
+		for (int j = 0; j < width[h]; ++j) {
+			struct eval_poly* l = &tree[h - 1][2 * j];
+			struct eval_poly* node = &tree[h][j];
+			if (2 * j + 1 < width[h - 1]) {
+				struct eval_poly* r = &tree[h - 1][2 * j + 1];
+				node->len = l->len + r->len - 1;
+				node->c = (unsigned long long*) malloc(node->len * sizeof(unsigned long long));
+				eval_poly_mul(l->c, l->len, r->c, r->len, node->c);
+			}
+			else {
+				node->len = l->len;
+				node->c = (unsigned long long*) malloc(node->len * sizeof(unsigned long long));
+				memcpy(node->c, l->c, l->len * sizeof(unsigned long long));
+			}
+		}
+	}
+
+	//Remainders down the tree: rem[j] at level h is f mod tree[h][j].
+	unsigned long long** rem = (unsigned long long**) malloc(sizeof(unsigned long long*));
+	struct eval_poly* root = &tree[levels - 1][0];
+	rem[0] = (unsigned long long*) malloc(root->len * sizeof(unsigned long long));
+	eval_poly_rem(f, lf, root->c, root->len, rem[0]);
+	for (int h = levels - 2; h >= 0; --h) {
+		unsigned long long** next = (unsigned long long**) malloc(width[h] * sizeof(unsigned long long*));
+		#pragma omp parallel for num_threads(thread_count) schedule(dynamic, 1) if(parallel_nodes)
+		for (int j = 0; j < width[h]; ++j) {
+			struct eval_poly* parent = &tree[h + 1][j / 2];
+			struct eval_poly* node = &tree[h][j];
+			next[j] = (unsigned long long*) malloc(node->len * sizeof(unsigned long long));
+			eval_poly_rem(rem[j / 2], parent->len - 1, node->c, node->len, next[j]);
+		}
+		for (int j = 0; j < width[h + 1]; ++j)
+			free(rem[j]);
+		free(rem);
+		rem = next;
+	}
+
+	//Leaves: f mod (group product) has the same values at the group's points.
+	#pragma omp parallel for num_threads(thread_count) schedule(dynamic, 1) if(parallel_nodes)
+	for (int j = 0; j < leaves; ++j) {
+		int start = j * EVAL_TREE_LEAF;
+		for (int i = start; i < start + tree[0][j].len - 1; ++i)
+			y[i] = eval_horner_scalar(rem[j], tree[0][j].len - 1, x[i]);
+	}
+
+	for (int j = 0; j < leaves; ++j)
+		free(rem[j]);
+	free(rem);
+	for (int h = 0; h < levels; ++h) {
+		for (int j = 0; j < width[h]; ++j)
+			free(tree[h][j].c);
+		free(tree[h]);
+	}
+	free(tree);
+	free(width);
+}
+
+// f at every point through subproduct trees over chunks of about deg(f) points. The chunks
+// run in parallel when there are enough of them, else the levels of each tree do.
+void eval_subproduct_tree(const unsigned long long* f, int len, const unsigned long long* x, unsigned long long* y, long points)
+{
+	int chunk = EVAL_TREE_LEAF;
+	while (chunk < len)
+		chunk <<= 1;
+	long chunks = (points + chunk - 1) / chunk;
+	int parallel_chunks = chunks >= thread_count;
+	#pragma omp parallel for num_threads(thread_count) schedule(dynamic, 1) if(parallel_chunks)
+	for (long c = 0; c < chunks; ++c) {
+		long start = c * chunk;
+		int count = (points - start < chunk) ? (int) (points - start) : chunk;
+		eval_tree_chunk(f, len, x + start, y + start, count, !parallel_chunks);
+	}
+}
+
+// -e mode: evaluate the product at eval_points random points with SIMD Horner (and with the
+// subproduct tree for -T), checking Horner on a sample with plain % and the tree against Horner.
+void run_evaluation(const long long* product, int len)
+{
+	struct timeval time_init;
+	struct timeval time_final;
+	unsigned long long* f = (unsigned long long*) malloc(len * sizeof(unsigned long long));
+	unsigned long long* x = (unsigned long long*) malloc(eval_points * sizeof(unsigned long long));
+	unsigned long long* y = (unsigned long long*) malloc(eval_points * sizeof(unsigned long long));
+	for (int i = 0; i < len; ++i)
+		f[i] = (unsigned long long) ((product[i] % (long long) EVAL_P + (long long) EVAL_P) % (long long) EVAL_P);
+	uint64_t key = crng_key(rng_seed, STREAM_EVAL);
+#	pragma omp parallel for num_threads(thread_count)
+	for (long i = 0; i < eval_points; ++i)
+		x[i] = crng_below(key, i, EVAL_P);
+
+	gettimeofday(&time_init, NULL);
+	eval_horner(f, len, x, y, eval_points);
+	gettimeofday(&time_final, NULL);
+	double running_time = get_running_time(time_final, time_init);
+	printf("Horner evaluation (%d SIMD lanes, mod %llu) at %ld points with %d threads took %lf seconds (%.0f points/second).\n"
+			, EVAL_LANES, EVAL_P, eval_points, thread_count, running_time, eval_points / running_time);
+	for (int s = 0; s < EVAL_CHECK_SAMPLES; ++s) {
+		long i = (s == 0) ? 0 : rand() % eval_points;
+		if (y[i] != eval_horner_scalar(f, len, x[i])) {
+			printf("WARNING: Horner value at point %ld differs from the scalar reference!\n", i);
+			break;
+		}
+	}
+
+	if (eval_tree) {
+		unsigned long long* y_tree = (unsigned long long*) malloc(eval_points * sizeof(unsigned long long));
+		gettimeofday(&time_init, NULL);
+		eval_subproduct_tree(f, len, x, y_tree, eval_points);
+		gettimeofday(&time_final, NULL);
+		running_time = get_running_time(time_final, time_init);
+		printf("Subproduct tree evaluation at %ld points with %d threads took %lf seconds (%.0f points/second).\n"
+				, eval_points, thread_count, running_time, eval_points / running_time);
+		for (long i = 0; i < eval_points; ++i) {
+			if (y_tree[i] != y[i]) {
+				printf("WARNING: y_tree[%ld] = %llu and y[%ld] = %llu are different!\n", i, y_tree[i], i, y[i]);
+				break;
+			}
+		}
+		free(y_tree);
+	}
+	free(f);
+	free(x);
+	free(y);
+}
+
+// ---- Schoolbook, Karatsuba and Toom-3 on 64-bit coefficients ----
+// 64-bit per-k schoolbook product of two length-m operands (serial base case).
+static void schoolbook_ll(const long long* a, const long long* b, int m, long long* r)
+{
+	for (int k = 0; k < 2 * m - 1; ++k) {
+		int i_min = (k - m + 1 > 0) ? k - m + 1 : 0;
+		int i_max = (k < m - 1) ? k : m - 1;
+		long long sum = 0;
+		for (int i = i_min; i <= i_max; ++i)
+			sum += a[i] * b[k - i];
+		r[k] = sum;
+	}
+}
+
+// Copy the input polynomials to 64-bit operands.
+static void load_operands(long long** a, long long** b)
+{
+	*a = (long long*) malloc(poly_order * sizeof(long long));
+	*b = (long long*) malloc(poly_order * sizeof(long long));
 	for (int i = 0; i < poly_order; ++i) {
-		for (int j = 0; j < poly_order; ++j) {
-			omp_multiply_coeffs[i] += poly_coeff0[i]*poly_coeff1[j];
+		(*a)[i] = poly_coeff0[i];
+		(*b)[i] = poly_coeff1[i];
+	}
+}
+
+// Schoolbook candidate of the dispatcher: omp_poly_multiply() into a fresh buffer, or
+// block by block when the product is streamed to a file (-o).
+long long* omp_convolution_multiply()
+{
+	int result_len = 2 * poly_order - 1;
+	long long* result = (long long*) malloc(result_len * sizeof(long long));
+	if (!stream_writer) {
+		omp_poly_multiply(result);
+		return result;
+	}
+	// Streaming: whole STREAM_BLOCK blocks per iteration, each queued once it is final.
+	int blocks = (result_len + STREAM_BLOCK - 1) / STREAM_BLOCK;
+	#pragma omp parallel for num_threads(thread_count) schedule(dynamic, 1)
+	for (int block = 0; block < blocks; ++block) {
+		int k_start = block * STREAM_BLOCK;
+		int k_end = (k_start + STREAM_BLOCK < result_len) ? k_start + STREAM_BLOCK : result_len;
+		for (int k = k_start; k < k_end; ++k) {
+			int i_min = (k - poly_order + 1 > 0) ? k - poly_order + 1 : 0;
+			int i_max = (k < poly_order - 1) ? k : poly_order - 1;
+			long long sum = 0;
+			for (int i = i_min; i <= i_max; ++i)
+				sum += (long long) poly_coeff0[i] * poly_coeff1[k - i];
+			result[k] = sum;
 		}
-		if (DEBUG == 2) {
-			printf("omp_multiply_coeffs[%d] = %d\n", i, omp_multiply_coeffs[i]);
+		poly_writer_submit(stream_writer, result + k_start, k_start, k_end - k_start);
+	}
+	return result;
+}
+
+// Karatsuba with h = ceil(m/2): r = z0 + x^h (z1 - z0 - z2) + x^2h z2, where z1 = (a0+a1)(b0+b1).
+// z0 and z2 run as OpenMP tasks near the top of the recursion.
+static void omp_karatsuba(const long long* a, const long long* b, int m, long long* r, int depth)
+{
+	if (m <= KARATSUBA_CUTOFF) {
+		schoolbook_ll(a, b, m, r);
+		return;
+	}
+	int h = (m + 1) / 2;
+	int l = m - h;
+	long long* sa = (long long*) malloc(h * sizeof(long long));
+	long long* sb = (long long*) malloc(h * sizeof(long long));
+	long long* z1 = (long long*) malloc((2 * h - 1) * sizeof(long long));
+	for (int i = 0; i < h; ++i) {
+		sa[i] = a[i] + ((i < l) ? a[h + i] : 0);
+		sb[i] = b[i] + ((i < l) ? b[h + i] : 0);
+	}
+	r[2 * h - 1] = 0;
+
+	#pragma omp task if(depth < TASK_DEPTH)
+	omp_karatsuba(a, b, h, r, depth + 1);
+	#pragma omp task if(depth < TASK_DEPTH)
+	omp_karatsuba(a + h, b + h, l, r + 2 * h, depth + 1);
+	omp_karatsuba(sa, sb, h, z1, depth + 1);
+	#pragma omp taskwait
+
+	for (int i = 0; i < 2 * h - 1; ++i)
+		z1[i] -= r[i];
+	for (int i = 0; i < 2 * l - 1; ++i)
+		z1[i] -= r[2 * h + i];
+	for (int i = 0; i < 2 * h - 1; ++i)
+		r[h + i] += z1[i];
+
+	free(sa);
+	free(sb);
+	free(z1);
+}
+
+long long* omp_karatsuba_multiply()
+{
+	long long *a, *b;
+	load_operands(&a, &b);
+	long long* result = (long long*) malloc((2 * poly_order - 1) * sizeof(long long));
+	#pragma omp parallel num_threads(thread_count)
+	#pragma omp single
+	omp_karatsuba(a, b, poly_order, result, 0);
+	free(a);
+	free(b);
+	return result;
+}
+
+// Toom-3: parts of k = ceil(m/3) evaluated at 0, 1, -1, -2, inf and interpolated with
+// Bodrato's sequence. Evaluation grows coefficients up to 7x per level, so a level is only
+// taken while its products stay clear of 64-bit overflow (bound = largest input coefficient).
+static int toom3_fits(double bound, int k)
+{
+	double eval = 7.0 * bound;
+	return eval * eval * (double) k * 4.0 < 4.0e18;
+}
+
+static void omp_toom3(const long long* a, const long long* b, int m, long long* r, double bound, int depth)
+{
+	int k = (m + 2) / 3;
+	int l = m - 2 * k;
+	if (m <= TOOM3_CUTOFF || l < 1 || !toom3_fits(bound, k)) {
+		schoolbook_ll(a, b, m, r);
+		return;
+	}
+	int plen = 2 * k - 1;
+	long long* ea = (long long*) malloc(3 * k * sizeof(long long));
+	long long* eb = (long long*) malloc(3 * k * sizeof(long long));
+	long long* prod = (long long*) malloc(5 * plen * sizeof(long long));
+
+	//Evaluate at 1, -1, -2 (the parts at 0 and inf are used in place).
+	for (int i = 0; i < k; ++i) {
+		long long a0 = a[i], a1 = a[k + i], a2 = (i < l) ? a[2 * k + i] : 0;
+		long long b0 = b[i], b1 = b[k + i], b2 = (i < l) ? b[2 * k + i] : 0;
+		ea[i] = a0 + a2 + a1;
+		ea[k + i] = a0 + a2 - a1;
+		ea[2 * k + i] = (ea[k + i] + a2) * 2 - a0;
+		eb[i] = b0 + b2 + b1;
+		eb[k + i] = b0 + b2 - b1;
+		eb[2 * k + i] = (eb[k + i] + b2) * 2 - b0;
+	}
+
+	#pragma omp task if(depth < TASK_DEPTH)
+	omp_toom3(a, b, k, prod, bound, depth + 1);
+	#pragma omp task if(depth < TASK_DEPTH)
+	omp_toom3(ea, eb, k, prod + plen, 3 * bound, depth + 1);
+	#pragma omp task if(depth < TASK_DEPTH)
+	omp_toom3(ea + k, eb + k, k, prod + 2 * plen, 3 * bound, depth + 1);
+	#pragma omp task if(depth < TASK_DEPTH)
+	omp_toom3(ea + 2 * k, eb + 2 * k, k, prod + 3 * plen, 7 * bound, depth + 1);
+	omp_toom3(a + 2 * k, b + 2 * k, l, prod + 4 * plen, bound, depth + 1);
+	#pragma omp taskwait
+
+	//Interpolation: r(0), r(1), r(-1), r(-2), r(inf) -> coefficients c0..c4.
+	long long *r0 = prod, *r1 = prod + plen, *rm1 = prod + 2 * plen, *rm2 = prod + 3 * plen, *rinf = prod + 4 * plen;
+	for (int i = 0; i < plen; ++i) {
+		long long inf = (i < 2 * l - 1) ? rinf[i] : 0;
+		long long c3 = (rm2[i] - r1[i]) / 3;
+		long long c1 = (r1[i] - rm1[i]) / 2;
+		long long c2 = rm1[i] - r0[i];
+		c3 = (c2 - c3) / 2 + 2 * inf;
+		c2 = c2 + c1 - inf;
+		c1 = c1 - c3;
+		r1[i] = c1;
+		rm1[i] = c2;
+		rm2[i] = c3;
+	}
+	int rlen = 2 * m - 1;
+	memset(r, 0, rlen * sizeof(long long));
+	for (int i = 0; i < plen; ++i) {
+		r[i] += r0[i];
+		if (k + i < rlen)
+			r[k + i] += r1[i];
+		if (2 * k + i < rlen)
+			r[2 * k + i] += rm1[i];
+		if (3 * k + i < rlen)
+			r[3 * k + i] += rm2[i];
+	}
+	for (int i = 0; i < 2 * l - 1; ++i)
+		r[4 * k + i] += rinf[i];
+
+	free(ea);
+	free(eb);
+	free(prod);
+}
+
+long long* omp_toom3_multiply()
+{
+	long long *a, *b;
+	load_operands(&a, &b);
+	long long* result = (long long*) malloc((2 * poly_order - 1) * sizeof(long long));
+	#pragma omp parallel num_threads(thread_count)
+	#pragma omp single
+	omp_toom3(a, b, poly_order, result, (double) coeff_bound, 0);
+	free(a);
+	free(b);
+	return result;
+}
+
+
+// ---- Products in Z_p ----
+// Reference: schoolbook with a full 128-bit reduction after every multiply.
+long long* serial_mod_multiply()
+{
+	int result_len = 2 * poly_order - 1;
+	uint64_t p = modulus.p;
+	long long* result = (long long*) malloc(result_len * sizeof(long long));
+	for (int k = 0; k < result_len; ++k) {
+		int i_min = (k - poly_order + 1 > 0) ? k - poly_order + 1 : 0;
+		int i_max = (k < poly_order - 1) ? k : poly_order - 1;
+		uint64_t sum = 0;
+		for (int i = i_min; i <= i_max; ++i) {
+			sum += poly_mod_mulmod(mod_coeff0[i], mod_coeff1[k - i], p);
+			if (sum >= p)
+				sum -= p;
 		}
+		result[k] = (long long) sum;
 	}
-	return;
+	return result;
+}
+
+// Per-k convolution with one operand in Montgomery form and the other reversed, so every
+// coefficient is a poly_mod_dot() that reduces once per lazy block of products.
+long long* omp_mod_multiply()
+{
+	int result_len = 2 * poly_order - 1;
+	int deg = poly_order - 1;
+	long long* result = (long long*) malloc(result_len * sizeof(long long));
+	uint64_t* a_mont = (uint64_t*) malloc(poly_order * sizeof(uint64_t));
+	uint64_t* b_rev = (uint64_t*) malloc(poly_order * sizeof(uint64_t));
+	#pragma omp parallel num_threads(thread_count)
+	{
+		#pragma omp for
+		for (int i = 0; i < poly_order; ++i) {
+			a_mont[i] = poly_mod_to_mont(&modulus, mod_coeff0[i]);
+			b_rev[i] = mod_coeff1[deg - i];
+		}
+		#pragma omp for schedule(dynamic, 64)
+		for (int k = 0; k < result_len; ++k) {
+			int i_min = (k - deg > 0) ? k - deg : 0;
+			int i_max = (k < deg) ? k : deg;
+			result[k] = (long long) poly_mod_dot(&modulus, a_mont + i_min, b_rev + (deg - k + i_min), i_max - i_min + 1);
+		}
+	}
+	free(a_mont);
+	free(b_rev);
+	return result;
+}
+
+
+// ---- Dispatcher ----
+// Run one of the product algorithms; the caller frees the 2*poly_order-1 coefficients.
+long long* dispatch_poly_multiply(int algorithm)
+{
+	if (DEBUG >= 1)
+		printf("In dispatch_poly_multiply (%s).\n", poly_alg_names[algorithm]);
+	switch (algorithm) {
+		case POLY_ALG_KARATSUBA:
+			return omp_karatsuba_multiply();
+		case POLY_ALG_TOOM3:
+			return omp_toom3_multiply();
+		case POLY_ALG_TRANSFORM:
+			return ntt_poly_multiply();
+		default:
+			return omp_convolution_multiply();
+	}
+}
+
+// Calibration callback: time one algorithm on fresh random polynomials of the given degree.
+static double time_algorithm(int algorithm, int degree)
+{
+	int saved_order = poly_order;
+	int* saved_coeff0 = poly_coeff0;
+	int* saved_coeff1 = poly_coeff1;
+	struct timeval time_init;
+	struct timeval time_final;
+
+	poly_order = degree + 1;
+	poly_coeff0 = (int*) malloc(poly_order * sizeof(int));
+	poly_coeff1 = (int*) malloc(poly_order * sizeof(int));
+	random_coeffs(poly_coeff0, poly_order, STREAM_COEFF0);
+	random_coeffs(poly_coeff1, poly_order, STREAM_COEFF1);
+
+	gettimeofday(&time_init, NULL);
+	long long* result = dispatch_poly_multiply(algorithm);
+	gettimeofday(&time_final, NULL);
+
+	free(result);
+	free(poly_coeff0);
+	free(poly_coeff1);
+	poly_order = saved_order;
+	poly_coeff0 = saved_coeff0;
+	poly_coeff1 = saved_coeff1;
+	return get_running_time(time_final, time_init);
+}
+
+// Measure the crossovers up to poly_order for this thread count and save them.
+int calibrate()
+{
+	static struct poly_profile profile;
+	poly_profile_load(PROFILE_PATH, &profile);
+	poly_calibrate(&profile, thread_count, poly_coeff_bits(COEFF_MAX), poly_order - 1, time_algorithm);
+	if (poly_profile_save(PROFILE_PATH, &profile) != 0) {
+		printf("Error: could not write %s.\n", PROFILE_PATH);
+		return 1;
+	}
+	printf("Profile saved to %s.\n", PROFILE_PATH);
+	return 0;
 }
 
 double get_running_time(struct timeval time_final, struct timeval time_init)
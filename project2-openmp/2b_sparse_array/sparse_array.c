@@ -8,9 +8,14 @@
 #include <omp.h>
 #endif
 
+#include "counter_rng.h"
+
 #define DEBUG 0
 #define SEED 12
 #define WRITE_FILE 1
+#define STREAM_MATRIX 0 // Counter RNG stream of each generated buffer
+#define STREAM_ZEROS 1
+#define STREAM_VECTOR 2
 
 // Functions
 void omp_build_csr(int **A, int rows, int cols, int nz, int *row_ptr, int *col_ind, int *values);     // Create the CSR format of the sparse array using parallel computation OpenMP
@@ -68,10 +73,11 @@ int main (int argc, char *argv[])
 	printf("Number of threads: %d\n\n", thread_count);
 
 	// Initialize random seed
+	uint64_t rng_seed;
 	if (DEBUG)
-		srand(SEED); // For reproducibility
+		rng_seed = SEED; // For reproducibility
 	else
-		srand(time(NULL));
+		rng_seed = time(NULL);
 	// Time arguments
 	struct timeval time_init;
 	struct timeval time_final;
@@ -95,13 +101,18 @@ int main (int argc, char *argv[])
 		
 	// Step 1.1: Square matrix dynamic allocation and initilization
 	// -- Initilization: First we initiliaze all the matrix cells with values from 1 to VALUES_MAX
+	// -- Cell (i, j) is element i*cols + j of a counter RNG stream, so the threads fill the rows in any order.
 	int rows = num_row_values;
  	int cols = num_row_values;
 	int **dense_matrix = malloc(rows * sizeof(int*));
 	for (int i = 0; i < rows; i++) {
 		dense_matrix[i] = malloc(cols * sizeof(int));
+	}
+	uint64_t matrix_key = crng_key(rng_seed, STREAM_MATRIX);
+#	pragma omp parallel for num_threads(thread_count)
+	for (int i = 0; i < rows; i++) {
 		for (int j = 0; j < cols; j++) {
-			dense_matrix[i][j] = (rand() % VALUES_MAX) + 1;
+			dense_matrix[i][j] = crng_int_in(matrix_key, (uint64_t)i * cols + j, 1, VALUES_MAX);
 		}
 	}
 
@@ -112,15 +123,12 @@ int main (int argc, char *argv[])
 	if (DEBUG)
 		printf("\n DEBUG: All number: %d, zeros number: %d, Values number: %d \n ", num_all_values, zeros_num, values_num);
 
+	// -- The first zeros_num elements of a random permutation of the cells are distinct, so no retries are needed
+	uint64_t zeros_key = crng_key(rng_seed, STREAM_ZEROS);
+#	pragma omp parallel for num_threads(thread_count)
 	for (int i = 0; i < zeros_num; i++) {
-		int row_ind, col_ind;
-		do {
-			row_ind = rand() % rows;  // pick indices
-			col_ind = rand() % cols;
-			// repeat if this cell is already zero
-		} while (dense_matrix[row_ind][col_ind] == 0);
-
-		dense_matrix[row_ind][col_ind] = 0;
+		uint64_t cell = crng_permute(zeros_key, i, num_all_values);
+		dense_matrix[cell / cols][cell % cols] = 0;
 	}
 
 	// DEBUG: Validate zero/non-zero counts and percentage
@@ -164,8 +172,10 @@ int main (int argc, char *argv[])
 
 	// Step 1.4: Vector allocation and initialization with values from 1 to VALUES_MAX.
 	int* vector = (int*) malloc(rows * sizeof(int));
+	uint64_t vector_key = crng_key(rng_seed, STREAM_VECTOR);
+#	pragma omp parallel for num_threads(thread_count)
 	for (int i = 0; i < rows; ++i) {
-		vector[i] = (rand() % VALUES_MAX) + 1;
+		vector[i] = crng_int_in(vector_key, i, 1, VALUES_MAX);
 	}
 
 
@@ -7,6 +7,8 @@
 #include <omp.h>
 #endif
 
+#include "counter_rng.h"
+
 #define DEBUG 0
 #define SEED 12
 #define WRITE_FILE 1
@@ -59,10 +61,11 @@ int main (int argc, char *argv[])
 	printf("Number of threads: %d\n\n", thread_count);
 
 	// Initialize random seed
+	uint64_t rng_seed;
 	if (DEBUG)
-		srand(SEED); // For reproducibility
+		rng_seed = SEED; // For reproducibility
 	else
-		srand(time(NULL));
+		rng_seed = time(NULL);
 	// Time arguments
 	struct timeval time_init;
 	struct timeval time_final;
@@ -90,12 +93,14 @@ int main (int argc, char *argv[])
 		printf("ERROR: Matrix size must be greater than 2!\n");
 		return 1;
 	}
-	srand(time(0));
+	// Values in [0, RAND_MAX] as before, generated in parallel (same matrix for any thread count).
 	A = (int*) malloc(msize*sizeof(int));
 	B = (int*) malloc(msize*sizeof(int));
+	uint64_t key = crng_key(rng_seed, 0);
+#	pragma omp parallel for num_threads(thread_count)
 	for (int i = 0; i < msize; ++i)	
 	{
-		A[i] = rand();
+		A[i] = crng_int_in(key, i, 0, RAND_MAX);
 	}
 	
 	//Step 2: Begin mergesort.